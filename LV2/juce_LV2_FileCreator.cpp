@@ -20,6 +20,7 @@
 #include "lv2/instance-access/instance-access.h"
 #include "lv2/midi/midi.h"
 #include "lv2/options/options.h"
+#include "lv2/patch/patch.h"
 #include "lv2/port-props/port-props.h"
 #include "lv2/presets/presets.h"
 #include "lv2/state/state.h"
@@ -27,6 +28,7 @@
 #include "lv2/ui/ui.h"
 #include "lv2/units/units.h"
 #include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
 #include "includes/lv2_external_ui.h"
 #include "includes/lv2_programs.h"
 
@@ -36,6 +38,9 @@
 
 using namespace juce;
 
+/** Creates a processor that describes the plugin from its text file without Pd (PluginDescriptor.cpp) */
+AudioProcessor* JUCE_CALLTYPE createPluginDescriptor();
+
 /** Plugin requires processing with a fixed/constant block size */
 #ifndef JucePlugin_WantsLV2FixedBlockSize
 #define JucePlugin_WantsLV2FixedBlockSize 0
@@ -46,6 +51,13 @@ using namespace juce;
 #define JucePlugin_WantsLV2Presets 1
 #endif
 
+/** Use non-parameter states (must match the wrapper) */
+#ifndef JucePlugin_WantsLV2State
+#define JucePlugin_WantsLV2State 1
+#endif
+
+#define JUCE_LV2_STATE_BINARY_URI "urn:juce:stateBinary"
+
 
 //==============================================================================
 /**
@@ -90,6 +102,12 @@ class JuceLV2FileCreator
         return pluginURI;
     }
     
+    /** Returns the URI of the property of a parameter (must match the wrapper) */
+    static const String getParameterURI(const int index)
+    {
+        return getPluginURI() + "#parameter" + String(index+1);
+    }
+    
     /** Queries all available plugin audio ports */
     static void findMaxTotalChannels (AudioProcessor* const filter, int& maxTotalIns, int& maxTotalOuts)
     {
@@ -263,6 +281,7 @@ class JuceLV2FileCreator
         text += "@prefix doap: <http://usefulinc.com/ns/doap#> .\n";
         text += "@prefix foaf: <http://xmlns.com/foaf/0.1/> .\n";
         text += "@prefix lv2:  <" LV2_CORE_PREFIX "> .\n";
+        text += "@prefix patch: <" LV2_PATCH_PREFIX "> .\n";
         text += "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n";
         text += "@prefix ui:   <" LV2_UI_PREFIX "> .\n";
         text += "@prefix unit: <" LV2_UNITS_PREFIX "> .\n";
@@ -276,10 +295,12 @@ class JuceLV2FileCreator
         text += "                        <" LV2_BUF_SIZE__fixedBlockLength "> ,\n";
 #endif
         text += "                        <" LV2_URID__map "> ;\n";
+        text += "    lv2:optionalFeature <" LV2_WORKER__schedule "> ;\n";
         text += "    lv2:extensionData <" LV2_OPTIONS__interface "> ,\n";
 #if JucePlugin_WantsLV2State
         text += "                      <" LV2_STATE__interface "> ,\n";
 #endif
+        text += "                      <" LV2_WORKER__interface "> ,\n";
         text += "                      <" LV2_PROGRAMS__Interface "> ;\n";
         text += "\n";
         
@@ -299,7 +320,7 @@ class JuceLV2FileCreator
         text += "    lv2:port [\n";
         text += "        a lv2:InputPort, atom:AtomPort ;\n";
         text += "        atom:bufferType atom:Sequence ;\n";
-        text += "        atom:supports <" LV2_MIDI__MidiEvent ">, <" LV2_TIME__Position "> ;\n";
+        text += "        atom:supports <" LV2_MIDI__MidiEvent ">, <" LV2_TIME__Position ">, <" LV2_PATCH__Message "> ;\n";
         text += "        lv2:index " + String(portIndex++) + " ;\n";
         text += "        lv2:symbol \"lv2_midi_in\" ;\n";
         text += "        lv2:name \"MIDI Input\" ;\n";
@@ -437,9 +458,45 @@ class JuceLV2FileCreator
                 text += "    ] ,\n";
         }
         
+        // Parameters as properties (patch:Set with the frame of the change)
+        for (int i = 0; i < params.size(); ++i)
+        {
+            if (i == 0)
+                text += "    patch:writable <" + getParameterURI(i) + ">";
+            else
+                text += " ,\n                   <" + getParameterURI(i) + ">";
+            
+            if (i+1 == params.size())
+                text += " ;\n\n";
+        }
+        
         text += "    doap:name \"" + filter->getName() + "\" ;\n";
         text += "    doap:maintainer [ foaf:name \"" + String(JucePlugin_Manufacturer) + "\" ] .\n";
         
+        for (int i = 0; i < params.size(); ++i)
+        {
+            String const paramName = params[i]->getName(1000);
+            text += "\n";
+            text += "<" + getParameterURI(i) + ">\n";
+            text += "    a lv2:Parameter ;\n";
+            text += "    rdfs:label \"" + (paramName.isNotEmpty() ? paramName : "Port " + String(i+1)) + "\" ;\n";
+            text += "    rdfs:range atom:Float ;\n";
+            
+            if(auto* rangeParam = dynamic_cast<RangedAudioParameter*>(params[i]))
+            {
+                auto const normRange = rangeParam->getNormalisableRange();
+                text += "    lv2:default " + String(normRange.convertFrom0to1(rangeParam->getDefaultValue()), 2) + " ;\n";
+                text += "    lv2:minimum " +  String(normRange.start, 2) + " ;\n";
+                text += "    lv2:maximum " + String(normRange.end, 2) + " .\n";
+            }
+            else
+            {
+                text += "    lv2:default " + String::formatted("%f", safeParamValue(params[i]->getDefaultValue())) + " ;\n";
+                text += "    lv2:minimum 0.0 ;\n";
+                text += "    lv2:maximum 1.0 .\n";
+            }
+        }
+        
         return text;
     }
     
@@ -474,15 +531,9 @@ class JuceLV2FileCreator
             filter->setCurrentProgram(i);
             preset += "<" + pluginURI + presetSeparator + "preset" + String::formatted("%03i", i+1) + "> a pset:Preset ;\n";
             
-            // State
+            // State (the descriptor can't run the patch, the preset only selects the program)
 #if JucePlugin_WantsLV2State
             preset += "    state:state [\n";
-#if JucePlugin_WantsLV2StateString
-            preset += "        <" JUCE_LV2_STATE_STRING_URI ">\n";
-            preset += "\"\"\"\n";
-            preset += filter->getStateInformationString().replace("\r\n","\n");
-            preset += "\"\"\"\n";
-#else
             MemoryBlock chunkMemory;
             filter->getCurrentProgramStateInformation(chunkMemory);
             const String chunkString(Base64::toBase64(chunkMemory.getData(), chunkMemory.getSize()));
@@ -491,44 +542,10 @@ class JuceLV2FileCreator
             preset += "            a atom:Chunk ;\n";
             preset += "            rdf:value \"" + chunkString + "\"^^xsd:base64Binary ;\n";
             preset += "        ] ;\n";
+            preset += "    ] .\n\n";
+#else
+            preset += "    lv2:appliesTo <" + pluginURI + "> .\n\n";
 #endif
-            if (filter->getParameters().size() == 0)
-            {
-                preset += "    ] .\n\n";
-                continue;
-            }
-            
-            preset += "    ] ;\n\n";
-#endif
-            
-            // Port values
-            getUsedSymbols().clear();
-            auto const& params = filter->getParameters();
-            for (int j = 0; j < params.size(); ++j)
-            {
-                if (j == 0)
-                {
-                    preset += "    lv2:port [\n";
-                }
-                else
-                {
-                    preset += "    [\n";
-                }
-                
-                String const paramName = params[j]->getName(1000);
-                preset += "        lv2:symbol \"" + nameToSymbol(paramName, j) + "\" ;\n";
-                preset += "        pset:value " + String::formatted("%f", safeParamValue(params[j]->getValue())) + " ;\n";
-                
-                if (j + 1 == params.size())
-                {
-                    preset += "    ] ";
-                }
-                else
-                {
-                    preset += "    ] ,\n";
-                }
-            }
-            preset += ".\n\n";
             
             text += preset;
         }
@@ -541,7 +558,7 @@ public:
     static void createLv2Files(const char* basename)
     {
         const ScopedJuceInitialiser_GUI juceInitialiser;
-        std::unique_ptr<AudioProcessor> filter(createPluginFilterOfType (AudioProcessor::wrapperType_LV2));
+        std::unique_ptr<AudioProcessor> filter(createPluginDescriptor());
         
         int maxNumInputChannels, maxNumOutputChannels;
         findMaxTotalChannels(filter.get(), maxNumInputChannels, maxNumOutputChannels);
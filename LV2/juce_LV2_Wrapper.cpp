@@ -33,11 +33,6 @@
 #define JucePlugin_WantsLV2State 1
 #endif
 
-/** States are strings, needs custom get/setStateInformationString */
-#ifndef JucePlugin_WantsLV2StateString
-#define JucePlugin_WantsLV2StateString 0
-#endif
-
 /** Export presets */
 #ifndef JucePlugin_WantsLV2Presets
 #define JucePlugin_WantsLV2Presets 1
@@ -48,12 +43,6 @@
 #define JucePlugin_WantsLV2TimePos 1
 #endif
 
-/** Using string states require enabling states first */
-#if JucePlugin_WantsLV2StateString && ! JucePlugin_WantsLV2State
-#undef JucePlugin_WantsLV2State
-#define JucePlugin_WantsLV2State 1
-#endif
-
 #if JUCE_LINUX && ! JUCE_AUDIOPROCESSOR_NO_GUI
 #include <X11/Xlib.h>
 #define JUCE_GUI_BASICS_INCLUDE_XHEADERS 1
@@ -74,6 +63,7 @@
 #include "lv2/instance-access/instance-access.h"
 #include "lv2/midi/midi.h"
 #include "lv2/options/options.h"
+#include "lv2/patch/patch.h"
 #include "lv2/port-props/port-props.h"
 #include "lv2/presets/presets.h"
 #include "lv2/state/state.h"
@@ -81,9 +71,14 @@
 #include "lv2/ui/ui.h"
 #include "lv2/units/units.h"
 #include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
 #include "includes/lv2_external_ui.h"
 #include "includes/lv2_programs.h"
 
+#include "../Source/PluginAutomation.h"
+#include "../Source/PluginStatePaths.h"
+#include "../Source/PluginWorker.h"
+
 #define JUCE_LV2_STATE_STRING_URI "urn:juce:stateString"
 #define JUCE_LV2_STATE_BINARY_URI "urn:juce:stateBinary"
 
@@ -108,6 +103,12 @@ static const String& getPluginURI()
     return pluginURI;
 }
 
+/** Returns the URI of the property of a parameter (must match the plugin file) */
+static const String getParameterURI(const int index)
+{
+    return getPluginURI() + "#parameter" + String(index+1);
+}
+
 //==============================================================================
 #if JUCE_LINUX
 
@@ -712,7 +713,11 @@ public:
     uridAtomInt (0),
     uridAtomLong (0),
     uridAtomSequence (0),
+    uridAtomURID (0),
     uridMidiEvent (0),
+    uridPatchSet (0),
+    uridPatchProperty (0),
+    uridPatchValue (0),
     uridTimePos (0),
     uridTimeBar (0),
     uridTimeBarBeat (0),
@@ -721,6 +726,10 @@ public:
     uridTimeBeatUnit (0),
     uridTimeFrame (0),
     uridTimeSpeed (0),
+    workerSchedule (nullptr),
+    worker (nullptr),
+    statePaths (nullptr),
+    automation (nullptr),
     usingNominalBlockLength (false)
     {
         inParameterChangedCallback = false;
@@ -765,6 +774,23 @@ public:
             }
         }
         
+        // the non real-time work is performed by the worker of the host if available
+        for (int i=0; features[i] != nullptr; ++i)
+        {
+            if (strcmp(features[i]->URI, LV2_WORKER__schedule) == 0)
+            {
+                workerSchedule = (const LV2_Worker_Schedule*)features[i]->data;
+                break;
+            }
+        }
+        
+        worker = dynamic_cast<CamomileWorker*>(filter.get());
+        statePaths = dynamic_cast<CamomileStatePaths*>(filter.get());
+        automation = dynamic_cast<CamomileAutomation*>(filter.get());
+        
+        if (worker != nullptr && workerSchedule != nullptr)
+            worker->useHostWorker();
+        
         // we require uridMap to work properly (it's set as required feature)
         jassert (uridMap != nullptr);
         
@@ -777,7 +803,11 @@ public:
             uridAtomInt = uridMap->map(uridMap->handle, LV2_ATOM__Int);
             uridAtomLong = uridMap->map(uridMap->handle, LV2_ATOM__Long);
             uridAtomSequence = uridMap->map(uridMap->handle, LV2_ATOM__Sequence);
+            uridAtomURID = uridMap->map(uridMap->handle, LV2_ATOM__URID);
             uridMidiEvent = uridMap->map(uridMap->handle, LV2_MIDI__MidiEvent);
+            uridPatchSet = uridMap->map(uridMap->handle, LV2_PATCH__Set);
+            uridPatchProperty = uridMap->map(uridMap->handle, LV2_PATCH__property);
+            uridPatchValue = uridMap->map(uridMap->handle, LV2_PATCH__value);
             uridTimePos = uridMap->map(uridMap->handle, LV2_TIME__Position);
             uridTimeBar = uridMap->map(uridMap->handle, LV2_TIME__bar);
             uridTimeBarBeat = uridMap->map(uridMap->handle, LV2_TIME__barBeat);
@@ -787,6 +817,10 @@ public:
             uridTimeFrame = uridMap->map(uridMap->handle, LV2_TIME__frame);
             uridTimeSpeed = uridMap->map(uridMap->handle, LV2_TIME__speed);
             
+            // the properties of the parameters set by patch:Set (see the plugin file)
+            for (int i=0; i < filter->getParameters().size(); ++i)
+                uridParameters.add (uridMap->map(uridMap->handle, getParameterURI(i).toRawUTF8()));
+            
             for (int i=0; features[i] != nullptr; ++i)
             {
                 if (strcmp(features[i]->URI, LV2_OPTIONS__options) == 0)
@@ -876,6 +910,43 @@ public:
         }
     }
     
+    /** Sets a parameter from a patch:Set message at a frame of the block */
+    void setParameterAt (const LV2_Atom_Object* obj, int frame)
+    {
+        LV2_Atom* property = nullptr;
+        LV2_Atom* value = nullptr;
+        
+        lv2_atom_object_get (obj,
+                             uridPatchProperty, &property,
+                             uridPatchValue, &value,
+                             nullptr);
+        
+        if (property == nullptr || property->type != uridAtomURID || value == nullptr)
+            return;
+        
+        const int index = uridParameters.indexOf (((LV2_Atom_URID*)property)->body);
+        if (index < 0)
+            return;
+        
+        hostUsesPatchSet = true;
+        
+        float newValue;
+        /**/ if (value->type == uridAtomFloat)
+            newValue = ((LV2_Atom_Float*)value)->body;
+        else if (value->type == uridAtomDouble)
+            newValue = static_cast<float>(((LV2_Atom_Double*)value)->body);
+        else if (value->type == uridAtomInt)
+            newValue = static_cast<float>(((LV2_Atom_Int*)value)->body);
+        else if (value->type == uridAtomLong)
+            newValue = static_cast<float>(((LV2_Atom_Long*)value)->body);
+        else
+            return;
+        
+        // the change is applied at the Pd tick of the frame, or at the start of the block
+        if (automation == nullptr || ! automation->addParameterChange (index, newValue, frame))
+            setParameter3 (index, newValue);
+    }
+    
     bool isParameterAutomatable3(int index)
     {
         if (auto* param = filter->getParameters()[index])
@@ -999,7 +1070,9 @@ public:
             return;
         }
         
-        // Check for updated parameters
+        // Check for updated parameters, the ports aren't scanned once the host uses patch:Set
+        // and the changes are queued at the start of the block, before the patch:Set changes
+        if (! hostUsesPatchSet)
         {
             float curValue;
             
@@ -1011,7 +1084,8 @@ public:
                     
                     if (lastControlValues[i] != curValue)
                     {
-                        setParameter3(i, curValue);
+                        if (automation == nullptr || ! automation->addParameterChange (i, curValue, 0))
+                            setParameter3(i, curValue);
                         lastControlValues.setUnchecked (i, curValue);
                     }
                 }
@@ -1062,6 +1136,12 @@ public:
                             continue;
                         }
 #endif
+                        if ((event->body.type == uridAtomBlank || event->body.type == uridAtomObject)
+                            && ((LV2_Atom_Object*)&event->body)->body.otype == uridPatchSet)
+                        {
+                            setParameterAt ((LV2_Atom_Object*)&event->body, static_cast<int>(event->time.frames));
+                            continue;
+                        }
 #if JucePlugin_WantsLV2TimePos
                         if (event->body.type == uridAtomBlank || event->body.type == uridAtomObject)
                         {
@@ -1218,6 +1298,10 @@ public:
             }
         }
         
+        // schedule the work requested during the block (the host may perform it immediately when freewheeling)
+        if (worker != nullptr && workerSchedule != nullptr)
+            worker->scheduleWork (scheduleWork, (void*)workerSchedule);
+        
 #if JucePlugin_WantsLV2TimePos
         // update timePos for next callback
         if (lastPositionData.speed != 0.0)
@@ -1385,69 +1469,170 @@ public:
         }
     }
     
-    LV2_State_Status lv2SaveState (LV2_State_Store_Function store, LV2_State_Handle stateHandle)
+    LV2_Worker_Status lv2Work (LV2_Worker_Respond_Function respond, LV2_Worker_Respond_Handle respondHandle,
+                               uint32_t size, const void* data)
     {
-        jassert (filter != nullptr);
+        if (worker == nullptr || size != sizeof(uint32_t))
+            return LV2_WORKER_ERR_UNKNOWN;
         
-#if JucePlugin_WantsLV2StateString
-        String stateData(filter->getStateInformationString().replace("\r\n","\n"));
-        CharPointer_UTF8 charData(stateData.toUTF8());
+        uint32_t work;
+        memcpy(&work, data, sizeof(uint32_t));
+        worker->performWork (work);
         
-        store (stateHandle,
-               uridMap->map(uridMap->handle, JUCE_LV2_STATE_STRING_URI),
-               charData.getAddress(),
-               charData.sizeInBytes(),
-               uridMap->map(uridMap->handle, LV2_ATOM__String),
-               LV2_STATE_IS_POD|LV2_STATE_IS_PORTABLE);
-#else
+        return respond (respondHandle, sizeof(uint32_t), &work);
+    }
+    
+    LV2_Worker_Status lv2WorkResponse (uint32_t size, const void* data)
+    {
+        if (worker == nullptr || size != sizeof(uint32_t))
+            return LV2_WORKER_ERR_UNKNOWN;
+        
+        uint32_t work;
+        memcpy(&work, data, sizeof(uint32_t));
+        worker->performWorkResponse (work);
+        
+        return LV2_WORKER_SUCCESS;
+    }
+    
+    static bool scheduleWork (void* handle, uint32_t work)
+    {
+        const LV2_Worker_Schedule* schedule = (const LV2_Worker_Schedule*)handle;
+        return schedule->schedule_work (schedule->handle, sizeof(uint32_t), &work) == LV2_WORKER_SUCCESS;
+    }
+    
+    /** The map-path and free-path features of the host used to convert the paths of the files referenced by a state */
+    struct StatePaths
+    {
+        const LV2_State_Map_Path* mapPath;
+        const LV2_State_Free_Path* freePath;
+        
+        StatePaths (const LV2_Feature* const* features)
+        : mapPath (nullptr),
+        freePath (nullptr)
+        {
+            for (int i = 0; features != nullptr && features[i] != nullptr; ++i)
+            {
+                if (strcmp(features[i]->URI, LV2_STATE__mapPath) == 0)
+                    mapPath = (const LV2_State_Map_Path*)features[i]->data;
+                else if (strcmp(features[i]->URI, LV2_STATE__freePath) == 0)
+                    freePath = (const LV2_State_Free_Path*)features[i]->data;
+            }
+        }
+        
+        std::string release (char* path) const
+        {
+            if (path == nullptr)
+                return {};
+            
+            std::string const result (path);
+            
+            if (freePath != nullptr)
+                freePath->free_path (freePath->handle, path);
+            else
+                free (path);
+            
+            return result;
+        }
+        
+        static std::string abstractPath (void* handle, std::string const& path)
+        {
+            const StatePaths* paths = (const StatePaths*)handle;
+            std::string const result (paths->release (paths->mapPath->abstract_path (paths->mapPath->handle, path.c_str())));
+            return result.empty() ? path : result;
+        }
+        
+        static std::string absolutePath (void* handle, std::string const& path)
+        {
+            const StatePaths* paths = (const StatePaths*)handle;
+            std::string const result (paths->release (paths->mapPath->absolute_path (paths->mapPath->handle, path.c_str())));
+            return result.empty() ? path : result;
+        }
+    };
+    
+    LV2_State_Status lv2SaveState (LV2_State_Store_Function store, LV2_State_Handle stateHandle, const LV2_Feature* const* features)
+    {
+        jassert (filter != nullptr);
+        
+        // the state is stored as a binary chunk, the files referenced are mapped by the host
+        StatePaths paths (features);
         MemoryBlock chunkMemory;
+        
+        if (statePaths != nullptr && paths.mapPath != nullptr)
+            statePaths->setPathConverters (StatePaths::abstractPath, StatePaths::absolutePath, &paths);
+        
         filter->getCurrentProgramStateInformation (chunkMemory);
         
+        if (statePaths != nullptr)
+            statePaths->setPathConverters (nullptr, nullptr, nullptr);
+        
         store (stateHandle,
                uridMap->map(uridMap->handle, JUCE_LV2_STATE_BINARY_URI),
                chunkMemory.getData(),
                chunkMemory.getSize(),
                uridMap->map(uridMap->handle, LV2_ATOM__Chunk),
                LV2_STATE_IS_POD|LV2_STATE_IS_PORTABLE);
-#endif
         
         return LV2_STATE_SUCCESS;
     }
     
-    LV2_State_Status lv2RestoreState (LV2_State_Retrieve_Function retrieve, LV2_State_Handle stateHandle, uint32_t flags)
+    LV2_State_Status lv2RestoreState (LV2_State_Retrieve_Function retrieve, LV2_State_Handle stateHandle, uint32_t flags,
+                                      const LV2_Feature* const* features)
     {
         jassert (filter != nullptr);
         
         size_t size = 0;
         uint32 type = 0;
         const void* data = retrieve (stateHandle,
-#if JucePlugin_WantsLV2StateString
-                                     uridMap->map(uridMap->handle, JUCE_LV2_STATE_STRING_URI),
-#else
                                      uridMap->map(uridMap->handle, JUCE_LV2_STATE_BINARY_URI),
-#endif
                                      &size, &type, &flags);
+        MemoryBlock legacyMemory;
         
-        if (data == nullptr || size == 0 || type == 0)
-            return LV2_STATE_ERR_UNKNOWN;
-        
-#if JucePlugin_WantsLV2StateString
-        if (type == uridMap->map (uridMap->handle, LV2_ATOM__String))
+        // the states saved by the previous versions are XML strings
+        if (data == nullptr)
         {
-            String stateData (CharPointer_UTF8(static_cast<const char*>(data)));
-            filter->setStateInformationString (stateData);
+            data = retrieve (stateHandle,
+                             uridMap->map(uridMap->handle, JUCE_LV2_STATE_STRING_URI),
+                             &size, &type, &flags);
             
-#if ! JUCE_AUDIOPROCESSOR_NO_GUI
-            if (ui != nullptr)
-                ui->repaint();
-#endif
+            if (data == nullptr || size == 0 || type != uridMap->map (uridMap->handle, LV2_ATOM__String))
+                return LV2_STATE_ERR_UNKNOWN;
             
-            return LV2_STATE_SUCCESS;
+            std::unique_ptr<XmlElement> xml (parseXML (String::fromUTF8 (static_cast<const char*>(data), static_cast<int>(size))));
+            
+            if (xml == nullptr)
+                return LV2_STATE_ERR_UNKNOWN;
+            
+            AudioProcessor::copyXmlToBinary (*xml, legacyMemory);
+            data = legacyMemory.getData();
+            size = legacyMemory.getSize();
+            type = uridMap->map (uridMap->handle, LV2_ATOM__Chunk);
         }
-#else
+        
+        if (size == 0 || type == 0)
+            return LV2_STATE_ERR_UNKNOWN;
+        
         if (type == uridMap->map (uridMap->handle, LV2_ATOM__Chunk))
         {
-            filter->setCurrentProgramStateInformation (data, static_cast<int>(size));
+            StatePaths paths (features);
+            
+            if (statePaths != nullptr && paths.mapPath != nullptr)
+                statePaths->setPathConverters (StatePaths::abstractPath, StatePaths::absolutePath, &paths);
+            
+            // the state is loaded by the worker if the host provides one to restore
+            const LV2_Worker_Schedule* schedule = nullptr;
+            
+            for (int i = 0; features != nullptr && features[i] != nullptr; ++i)
+            {
+                if (strcmp(features[i]->URI, LV2_WORKER__schedule) == 0)
+                    schedule = (const LV2_Worker_Schedule*)features[i]->data;
+            }
+            
+            if (worker == nullptr || schedule == nullptr
+                || ! worker->scheduleState (data, static_cast<int>(size), scheduleWork, (void*)schedule))
+                filter->setCurrentProgramStateInformation (data, static_cast<int>(size));
+            
+            if (statePaths != nullptr)
+                statePaths->setPathConverters (nullptr, nullptr, nullptr);
             
 #if ! JUCE_AUDIOPROCESSOR_NO_GUI
             if (ui != nullptr)
@@ -1456,7 +1641,6 @@ public:
             
             return LV2_STATE_SUCCESS;
         }
-#endif
         
         return LV2_STATE_ERR_BAD_TYPE;
     }
@@ -1555,7 +1739,11 @@ private:
     LV2_URID uridAtomInt;
     LV2_URID uridAtomLong;
     LV2_URID uridAtomSequence;
+    LV2_URID uridAtomURID;
     LV2_URID uridMidiEvent;
+    LV2_URID uridPatchSet;
+    LV2_URID uridPatchProperty;
+    LV2_URID uridPatchValue;
     LV2_URID uridTimePos;
     LV2_URID uridTimeBar;
     LV2_URID uridTimeBarBeat;
@@ -1565,6 +1753,13 @@ private:
     LV2_URID uridTimeFrame;          // timeInSamples
     LV2_URID uridTimeSpeed;
     
+    const LV2_Worker_Schedule* workerSchedule;
+    CamomileWorker* worker;
+    CamomileStatePaths* statePaths;
+    CamomileAutomation* automation;
+    bool hostUsesPatchSet = false;
+    Array<LV2_URID> uridParameters;
+    
     bool usingNominalBlockLength; // if false use maxBlockLength
     
     LV2_Program_Descriptor progDesc;
@@ -1631,15 +1826,26 @@ static void juceLV2_selectProgram (LV2_Handle handle, uint32_t bank, uint32_t pr
 }
 
 static LV2_State_Status juceLV2_SaveState (LV2_Handle handle, LV2_State_Store_Function store, LV2_State_Handle stateHandle,
-                                           uint32_t, const LV2_Feature* const*)
+                                           uint32_t, const LV2_Feature* const* features)
 {
-    return handlePtr->lv2SaveState(store, stateHandle);
+    return handlePtr->lv2SaveState(store, stateHandle, features);
 }
 
 static LV2_State_Status juceLV2_RestoreState (LV2_Handle handle, LV2_State_Retrieve_Function retrieve, LV2_State_Handle stateHandle,
-                                              uint32_t flags, const LV2_Feature* const*)
+                                              uint32_t flags, const LV2_Feature* const* features)
+{
+    return handlePtr->lv2RestoreState(retrieve, stateHandle, flags, features);
+}
+
+static LV2_Worker_Status juceLV2_Work (LV2_Handle handle, LV2_Worker_Respond_Function respond, LV2_Worker_Respond_Handle respondHandle,
+                                       uint32_t size, const void* data)
+{
+    return handlePtr->lv2Work(respond, respondHandle, size, data);
+}
+
+static LV2_Worker_Status juceLV2_WorkResponse (LV2_Handle handle, uint32_t size, const void* data)
 {
-    return handlePtr->lv2RestoreState(retrieve, stateHandle, flags);
+    return handlePtr->lv2WorkResponse(size, data);
 }
 
 #undef handlePtr
@@ -1649,6 +1855,7 @@ static const void* juceLV2_ExtensionData (const char* uri)
     static const LV2_Options_Interface options = { juceLV2_getOptions, juceLV2_setOptions };
     static const LV2_Programs_Interface programs = { juceLV2_getProgram, juceLV2_selectProgram };
     static const LV2_State_Interface state = { juceLV2_SaveState, juceLV2_RestoreState };
+    static const LV2_Worker_Interface worker = { juceLV2_Work, juceLV2_WorkResponse, nullptr };
     
     if (strcmp(uri, LV2_OPTIONS__interface) == 0)
         return &options;
@@ -1656,6 +1863,8 @@ static const void* juceLV2_ExtensionData (const char* uri)
         return &programs;
     if (strcmp(uri, LV2_STATE__interface) == 0)
         return &state;
+    if (strcmp(uri, LV2_WORKER__interface) == 0)
+        return &worker;
     
     return nullptr;
 }
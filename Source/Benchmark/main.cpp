@@ -0,0 +1,359 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "../PluginProcessor.h"
+#include "../PluginEnvironment.h"
+#include "../PluginRealtime.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// ======================================================================================== //
+//                                      ALLOCATIONS                                         //
+// ======================================================================================== //
+
+// The allocations are only counted on the thread that calls processBlock while it runs.
+// With the real-time checker, the operators are already replaced and the allocations and
+// the locks are counted by the checker. Otherwise, the operators new are replaced and, on
+// Linux, malloc, calloc and realloc are wrapped by the linker (--wrap) so the allocations of
+// Pd are counted too. Elsewhere, only the operators new are counted.
+static thread_local bool  benchmark_counting = false;
+static std::atomic<int64> benchmark_allocations(0);
+
+#if !CAMOMILE_RT_CHECK
+
+static inline void countAllocation() noexcept
+{
+    if(benchmark_counting)
+    {
+        ++benchmark_allocations;
+    }
+}
+
+#if CAMOMILE_BENCHMARK_WRAP
+
+extern "C"
+{
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t count, size_t size);
+    void* __real_realloc(void* ptr, size_t size);
+
+    void* __wrap_malloc(size_t size)
+    {
+        countAllocation();
+        return __real_malloc(size);
+    }
+
+    void* __wrap_calloc(size_t count, size_t size)
+    {
+        countAllocation();
+        return __real_calloc(count, size);
+    }
+
+    void* __wrap_realloc(void* ptr, size_t size)
+    {
+        countAllocation();
+        return __real_realloc(ptr, size);
+    }
+}
+
+// The operators use the real function so the allocations aren't counted twice
+#define BENCHMARK_MALLOC __real_malloc
+
+#else
+
+#define BENCHMARK_MALLOC std::malloc
+
+#endif
+
+void* operator new(std::size_t size)
+{
+    countAllocation();
+    if(void* ptr = BENCHMARK_MALLOC(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    countAllocation();
+    return BENCHMARK_MALLOC(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    countAllocation();
+    return BENCHMARK_MALLOC(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::nothrow_t const&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::nothrow_t const&) noexcept
+{
+    std::free(ptr);
+}
+
+#endif
+
+#if CAMOMILE_BENCHMARK_WRAP || CAMOMILE_RT_WRAP
+static const char* const benchmark_counted = "new, malloc";
+#else
+static const char* const benchmark_counted = "new";
+#endif
+
+// ======================================================================================== //
+//                                          BENCHMARK                                       //
+// ======================================================================================== //
+
+static const double benchmark_samplerate = 48000.;
+static const double benchmark_duration   = 2.;
+static const int    benchmark_warmup     = 16;
+static const int    benchmark_blocksizes[] = {32, 64, 100, 128, 256, 441, 512, 1000, 1024, 2048, 4096};
+static const int    benchmark_densities[]  = {0, 10, 100, 1000}; // MIDI events per second
+
+//! @brief Fills the MIDI buffer with notes at the given density.
+static void fillMidiBuffer(MidiBuffer& buffer, int blocksize, int density, double& accumulator, int& pitch)
+{
+    buffer.clear();
+    if(density <= 0)
+    {
+        return;
+    }
+    accumulator += static_cast<double>(density) * static_cast<double>(blocksize) / benchmark_samplerate;
+    int const nevents = static_cast<int>(accumulator);
+    accumulator -= static_cast<double>(nevents);
+    for(int i = 0; i < nevents; ++i)
+    {
+        int const position = (i * blocksize) / std::max(nevents, 1);
+        bool const noteon = (pitch & 1) == 0;
+        buffer.addEvent(noteon ? MidiMessage::noteOn(1, 36 + (pitch >> 1) % 48, static_cast<uint8>(100)) :
+                        MidiMessage::noteOff(1, 36 + (pitch >> 1) % 48), position);
+        ++pitch;
+    }
+}
+
+//! @brief Runs the processor with a block size, a layout and a MIDI density.
+static var runConfiguration(CamomileAudioProcessor& processor, int blocksize, int density)
+{
+    processor.prepareToPlay(benchmark_samplerate, blocksize);
+    int const nchannels = std::max(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+    AudioBuffer<float> buffer(std::max(nchannels, 1), blocksize);
+    MidiBuffer midi;
+    midi.ensureSize(4096);
+    Random random(0);
+    double accumulator = 0.;
+    int pitch = 0;
+
+    int const nblocks = std::max(static_cast<int>(benchmark_duration * benchmark_samplerate) / blocksize, 32);
+    int64 nanoseconds = 0;
+    benchmark_allocations = 0;
+    size_t rtallocations = 0, rtlocks = 0;
+    for(int i = -benchmark_warmup; i < nblocks; ++i)
+    {
+        for(int j = 0; j < buffer.getNumChannels(); ++j)
+        {
+            float* samples = buffer.getWritePointer(j);
+            for(int k = 0; k < blocksize; ++k)
+            {
+                samples[k] = random.nextFloat() * 2.f - 1.f;
+            }
+        }
+        fillMidiBuffer(midi, blocksize, density, accumulator, pitch);
+
+        if(i == 0)
+        {
+            rtallocations = CamomileRealtimeChecker::getNumOperations(CamomileRealtimeChecker::Allocation);
+            rtlocks = CamomileRealtimeChecker::getNumOperations(CamomileRealtimeChecker::Lock);
+        }
+        auto const start = std::chrono::steady_clock::now();
+        benchmark_counting = i >= 0;
+        processor.processBlock(buffer, midi);
+        benchmark_counting = false;
+        auto const end = std::chrono::steady_clock::now();
+        if(i >= 0)
+        {
+            nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        }
+    }
+    processor.releaseResources();
+    size_t const nlocks = CamomileRealtimeChecker::getNumOperations(CamomileRealtimeChecker::Lock) - rtlocks;
+#if CAMOMILE_RT_CHECK
+    benchmark_allocations = static_cast<int64>(CamomileRealtimeChecker::getNumOperations(CamomileRealtimeChecker::Allocation) - rtallocations);
+#else
+    ignoreUnused(rtallocations, nlocks);
+#endif
+
+    // The ticks are measured by the load meters of the processor, the statistics of the last
+    // window (one second of audio) are used. The overhead is the time of a tick spent out of
+    // the DSP (the messages, the MIDI, the parameters and the GUIs).
+    auto const ticks = processor.getTickLoad();
+    auto const dsp = processor.getDSPLoad();
+
+    double const nsamples = static_cast<double>(nblocks) * static_cast<double>(blocksize);
+    DynamicObject::Ptr result(new DynamicObject());
+    result->setProperty("blocksize", blocksize);
+    result->setProperty("inputs", processor.getTotalNumInputChannels());
+    result->setProperty("outputs", processor.getTotalNumOutputChannels());
+    result->setProperty("midi_density", density);
+    result->setProperty("blocks", nblocks);
+    result->setProperty("ns_per_sample", static_cast<double>(nanoseconds) / nsamples);
+    result->setProperty("ns_per_block", static_cast<double>(nanoseconds) / static_cast<double>(nblocks));
+    result->setProperty("ns_per_tick", static_cast<double>(ticks.mean) * 1000.);
+    result->setProperty("ns_per_tick_p99", static_cast<double>(ticks.p99) * 1000.);
+    result->setProperty("ns_dsp_per_tick", static_cast<double>(dsp.mean) * 1000.);
+    result->setProperty("ns_overhead_per_tick", std::max(static_cast<double>(ticks.mean - dsp.mean) * 1000., 0.));
+    result->setProperty("allocations_per_block", static_cast<double>(benchmark_allocations.load()) / static_cast<double>(nblocks));
+    result->setProperty("allocations_counted", benchmark_counted);
+#if CAMOMILE_RT_CHECK
+    result->setProperty("locks_per_block", static_cast<double>(nlocks) / static_cast<double>(nblocks));
+#endif
+    return var(result.get());
+}
+
+//! @brief Gets the layouts of the buses supported by the plugin.
+static Array<AudioProcessor::BusesLayout> getLayouts(CamomileAudioProcessor& processor)
+{
+    Array<AudioProcessor::BusesLayout> layouts;
+    for(auto const& envLayout : CamomileEnvironment::getBusesLayouts())
+    {
+        AudioProcessor::BusesLayout layout;
+        for(auto const& envBus : envLayout)
+        {
+            layout.inputBuses.add(AudioChannelSet::canonicalChannelSet(static_cast<int>(envBus.inputs)));
+            layout.outputBuses.add(AudioChannelSet::canonicalChannelSet(static_cast<int>(envBus.outputs)));
+        }
+        if(processor.checkBusesLayoutSupported(layout))
+        {
+            layouts.addIfNotAlreadyThere(layout);
+        }
+    }
+    if(layouts.isEmpty())
+    {
+        layouts.add(processor.getBusesLayout());
+    }
+    return layouts;
+}
+
+//! @brief Benchmarks a plugin and prints the results as JSON.
+static int benchmarkPlugin(String const& folder)
+{
+    if(!CamomileEnvironment::initialize(folder.toStdString()))
+    {
+        for(auto const& error : CamomileEnvironment::getErrors())
+        {
+            std::cerr << "error: " << error << "\n";
+        }
+        return 1;
+    }
+    std::unique_ptr<CamomileAudioProcessor> processor(new CamomileAudioProcessor());
+    Array<var> configurations;
+    for(auto const& layout : getLayouts(*processor))
+    {
+        if(!processor->setBusesLayout(layout))
+        {
+            continue;
+        }
+        for(auto const blocksize : benchmark_blocksizes)
+        {
+            for(auto const density : benchmark_densities)
+            {
+                if(density > 0 && !processor->acceptsMidi())
+                {
+                    continue;
+                }
+                configurations.add(runConfiguration(*processor, blocksize, density));
+            }
+        }
+    }
+    DynamicObject::Ptr result(new DynamicObject());
+    result->setProperty("plugin", String(CamomileEnvironment::getPluginName()));
+    result->setProperty("samplerate", benchmark_samplerate);
+    result->setProperty("configurations", configurations);
+    std::cout << JSON::toString(var(result.get()), true) << "\n";
+    return 0;
+}
+
+//! @brief Benchmarks each plugin of a directory in its own process (the environment of a\n
+//! plugin is global) and prints the results as a JSON array.
+static int benchmarkDirectory(String const& executable, File const& directory)
+{
+    Array<var> results;
+    int nerrors = 0;
+    for(auto const& folder : directory.findChildFiles(File::findDirectories, false))
+    {
+        if(!folder.getChildFile(folder.getFileName() + ".txt").existsAsFile())
+        {
+            continue;
+        }
+        ChildProcess process;
+        if(!process.start(StringArray({executable, "--plugin", folder.getFullPathName()}), ChildProcess::wantStdOut))
+        {
+            std::cerr << "error: can't start the benchmark of " << folder.getFileName() << "\n";
+            ++nerrors;
+            continue;
+        }
+        auto const output = process.readAllProcessOutput();
+        var const result = JSON::parse(output);
+        if(process.getExitCode() != 0 || !result.isObject())
+        {
+            std::cerr << "error: the benchmark of " << folder.getFileName() << " failed\n";
+            ++nerrors;
+            continue;
+        }
+        results.add(result);
+    }
+    std::cout << JSON::toString(var(results)) << "\n";
+    return nerrors > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juce;
+    if(argc == 3 && String(argv[1]) == "--plugin")
+    {
+        return benchmarkPlugin(String(CharPointer_UTF8(argv[2])));
+    }
+    if(argc == 2)
+    {
+        auto const executable = File::getSpecialLocation(File::currentExecutableFile).getFullPathName();
+        return benchmarkDirectory(executable, File(String(CharPointer_UTF8(argv[1]))));
+    }
+    std::cout << "usage: camomile-benchmark <directory of plugins> | --plugin <plugin folder>\n"
+              << "The results (ns per sample, ns per Pd tick and its DSP, allocations per block) are printed as JSON.\n";
+    return 1;
+}
@@ -5,6 +5,9 @@
  */
 
 #include "PdArray.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 extern "C"
 {
@@ -58,22 +61,175 @@ namespace pd
     {
         libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
         int const size = libpd_arraysize(m_name.c_str());
+        if(size < 0)
+        {
+            throw std::runtime_error("array " + m_name + " doesn't exist");
+        }
         output.resize(static_cast<size_t>(size));
-        libpd_read_array(output.data(), m_name.c_str(), 0, size);
+        // the lock is acquired for each chunk so the audio thread is never blocked long
+        for(int start = 0; start < size; start += static_cast<int>(chunk_size))
+        {
+            int const length = std::min(static_cast<int>(chunk_size), size - start);
+            if(libpd_read_array(output.data()+start, m_name.c_str(), start, length))
+            {
+                throw std::runtime_error("array " + m_name + " can't be read");
+            }
+        }
+    }
+    
+    void Array::read(std::vector<float>& output, size_t start, size_t size) const
+    {
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        if(start + size > output.size() ||
+           libpd_read_array(output.data()+start, m_name.c_str(), static_cast<int>(start), static_cast<int>(size)))
+        {
+            throw std::runtime_error("array " + m_name + " can't be read");
+        }
+    }
+    
+    size_t Array::getChecksums(std::vector<uint32_t>& output) const
+    {
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        int const size = libpd_arraysize(m_name.c_str());
+        if(size < 0)
+        {
+            throw std::runtime_error("array " + m_name + " doesn't exist");
+        }
+        // each chunk is copied with the lock held and hashed once the lock is released so
+        // the audio thread is never blocked for more than the copy of one chunk
+        std::array<float, chunk_size> values;
+        output.resize((static_cast<size_t>(size) + chunk_size - 1) / chunk_size);
+        for(size_t i = 0; i < output.size(); ++i)
+        {
+            int const start  = static_cast<int>(i * chunk_size);
+            int const length = std::min(static_cast<int>(chunk_size), size - start);
+            if(libpd_read_array(values.data(), m_name.c_str(), start, length))
+            {
+                throw std::runtime_error("array " + m_name + " can't be read");
+            }
+            uint32_t hash = 2166136261u;
+            for(int j = 0; j < length; ++j)
+            {
+                uint32_t word;
+                std::memcpy(&word, values.data()+j, sizeof(word));
+                hash = (hash ^ word) * 16777619u;
+            }
+            output[i] = hash;
+        }
+        return static_cast<size_t>(size);
+    }
+    
+    size_t Array::getVersion(uint32_t& version) const
+    {
+        unsigned int value = 0;
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        int const size = libpd_array_get_version(m_name.c_str(), &value);
+        if(size < 0)
+        {
+            throw std::runtime_error("array " + m_name + " doesn't exist");
+        }
+        version = static_cast<uint32_t>(value);
+        return static_cast<size_t>(size);
     }
     
     void Array::write(std::vector<float> const& input)
     {
         libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
-        libpd_write_array(m_name.c_str(), 0, input.data(), static_cast<int>(input.size()));
+        int const size = libpd_arraysize(m_name.c_str());
+        if(size < 0)
+        {
+            throw std::runtime_error("array " + m_name + " doesn't exist");
+        }
+        if(libpd_array_is_readonly(m_name.c_str()) == 1)
+        {
+            throw std::runtime_error("array " + m_name + " is shared and can't be written");
+        }
+        // the common values are written even if the array has been resized since they were read
+        int const count = std::min(size, static_cast<int>(input.size()));
+        for(int start = 0; start < count; start += static_cast<int>(chunk_size))
+        {
+            libpd_write_array(m_name.c_str(), start, input.data()+start, std::min(static_cast<int>(chunk_size), count - start));
+        }
+        libpd_array_touch(m_name.c_str());
+        if(static_cast<size_t>(size) != input.size())
+        {
+            throw std::runtime_error("array " + m_name + " has " + std::to_string(size) + " values instead of "
+                                     + std::to_string(input.size()));
+        }
     }
     
     void Array::write(const size_t pos, float const input)
     {
         libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        if(libpd_array_is_readonly(m_name.c_str()) == 1)
+        {
+            throw std::runtime_error("array " + m_name + " is shared and can't be written");
+        }
         libpd_write_array(m_name.c_str(), static_cast<int>(pos), &input, 1);
+        libpd_array_touch(m_name.c_str());
+    }
+    
+    bool Array::swap(void*& vector, size_t& size) noexcept
+    {
+        void* oldvector = nullptr;
+        int oldsize = 0;
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        if(libpd_array_swap(m_name.c_str(), vector, static_cast<int>(size), &oldvector, &oldsize))
+        {
+            return false;
+        }
+        vector = oldvector;
+        size = static_cast<size_t>(oldsize);
+        return true;
+    }
+    
+    void Array::share(void*& vector, size_t& size)
+    {
+        void* oldvector = nullptr;
+        int oldsize = 0;
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        int const result = libpd_array_share(m_name.c_str(), vector, static_cast<int>(size), &oldvector, &oldsize);
+        if(result == -2)
+        {
+            throw std::runtime_error("array " + m_name + " is already shared");
+        }
+        else if(result)
+        {
+            throw std::runtime_error("array " + m_name + " doesn't exist");
+        }
+        vector = oldvector;
+        size = static_cast<size_t>(oldsize);
+    }
+    
+    void Array::unshare(void* vector, size_t size)
+    {
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        if(libpd_array_unshare(m_name.c_str(), vector, static_cast<int>(size)))
+        {
+            throw std::runtime_error("array " + m_name + " doesn't exist");
+        }
+    }
+    
+    void* Array::allocate(std::vector<float> const& values)
+    {
+        void* vector = libpd_array_allocate(values.data(), static_cast<int>(values.size()));
+        if(vector == nullptr)
+        {
+            throw std::runtime_error("can't allocate the array");
+        }
+        return vector;
+    }
+    
+    void Array::release(void* vector, size_t size)
+    {
+        if(vector)
+        {
+            libpd_array_free(vector, static_cast<int>(size));
+        }
+    }
+    
+    size_t Array::getWordSize() noexcept
+    {
+        return static_cast<size_t>(libpd_array_word_size());
     }
 }
-
-
-
@@ -9,6 +9,7 @@
 #include <vector>
 #include <array>
 #include <cstddef>
+#include <cstdint>
 
 namespace pd
 {
@@ -51,13 +52,65 @@ namespace pd
         std::array<float, 2> getScale() const noexcept;
         
         //! @brief Gets the values of the array.
+        //! @details The values are read by chunks of chunk_size values and the lock is\n
+        //! acquired for each chunk, so the chunks can come from different ticks.
         void read(std::vector<float>& output) const;
         
+        //! @brief Gets a range of values of the array.
+        //! @details The output must be at least as large as the array.
+        void read(std::vector<float>& output, size_t start, size_t size) const;
+        
+        //! @brief Gets the checksums of the array and returns the size of the array.
+        //! @details The array is split in chunks of chunk_size values and a checksum is\n
+        //! computed for each chunk, so the ranges modified since the last call can be found\n
+        //! without keeping a copy of the array. The lock is only held to copy each chunk, the\n
+        //! checksums are computed without it.
+        size_t getChecksums(std::vector<uint32_t>& output) const;
+        
+        //! @brief Gets the version of the array and returns the size of the array.
+        //! @details The version changes each time the array is written, swapped or resized by\n
+        //! Camomile. The objects of Pd that write the array directly (tabwrite~) don't change\n
+        //! the version so the readers must still check the checksums from time to time.
+        size_t getVersion(uint32_t& version) const;
+        
+        //! @brief The number of values of the chunks of the checksums.
+        static const size_t chunk_size = 1024;
+        
         //! @brief Writes the values of the array.
+        //! @details The values are written by chunks like they are read. If the sizes differ,\n
+        //! the common values are written and an exception is thrown so the mismatch can be\n
+        //! reported. Throws if the array is shared (read-only).
         void write(std::vector<float> const& input);
         
         //! @brief Writes a value of the array.
+        //! @details Throws if the array is shared (read-only).
         void write(const size_t pos, float const input);
+        
+        //! @brief Replaces the values of the array by a vector created with allocate().
+        //! @details The array is resized without allocation or copy, the vector and the size\n
+        //! are replaced by the previous ones that must be freed with release(). Like a resize,\n
+        //! the array is redrawn and the DSP chain is rebuilt if the array is used by the DSP.\n
+        //! The method is meant to be called between two ticks, it doesn't throw and returns\n
+        //! false if the array doesn't exist or is shared.
+        bool swap(void*& vector, size_t& size) noexcept;
+        
+        //! @brief Replaces the values of the array by a vector that isn't owned by Pd.
+        //! @details The vector is never freed or reallocated by Pd, the resize of the array,\n
+        //! the swap and the writes of Camomile are refused until unshare() restores the\n
+        //! previous vector.
+        void share(void*& vector, size_t& size);
+        
+        //! @brief Restores the vector of the array replaced by share().
+        void unshare(void* vector, size_t size);
+        
+        //! @brief Creates a vector that can replace the values of an array.
+        static void* allocate(std::vector<float> const& values);
+        
+        //! @brief Frees a vector created with allocate() or returned by swap().
+        static void release(void* vector, size_t size);
+        
+        //! @brief Gets the size in bytes of a value in the vector of an array.
+        static size_t getWordSize() noexcept;
     private:
     
         Array(std::string const& name, void* instance);
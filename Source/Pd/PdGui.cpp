@@ -4,8 +4,10 @@
  // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
  */
 
+#include <algorithm>
 #include <limits>
 #include <cmath>
+#include <cstring>
 
 #include "PdGui.hpp"
 #include "PdInstance.hpp"
@@ -321,7 +323,10 @@ namespace pd
         else
         {
             m_instance->setThis();
-            return atom_getsymbol(fake_gatom_getatom(static_cast<t_fake_gatom*>(m_ptr)))->s_name;
+            sys_lock();
+            std::string symbol(atom_getsymbol(fake_gatom_getatom(static_cast<t_fake_gatom*>(m_ptr)))->s_name);
+            sys_unlock();
+            return symbol;
         }
     }
     
@@ -340,7 +345,7 @@ namespace pd
         {
             std::vector<Atom> array;
             m_instance->setThis();
-            
+            sys_lock();
             int ac = binbuf_getnatom(static_cast<t_fake_gatom*>(m_ptr)->a_text.te_binbuf);
             t_atom *av = binbuf_getvec(static_cast<t_fake_gatom*>(m_ptr)->a_text.te_binbuf);
             array.reserve(ac);
@@ -359,6 +364,7 @@ namespace pd
                     array.push_back({});
                 }
             }
+            sys_unlock();
             return array;
         }
     }
@@ -461,7 +467,143 @@ namespace pd
         }
         return Patch();
     }
+
+    // ==================================================================================== //
+    //                                      SNAPSHOT                                        //
+    // ==================================================================================== //
+
+    int Gui::watch() const noexcept
+    {
+        if(!m_ptr || m_type == Type::Undefined || m_type == Type::Panel || m_type == Type::VuMeter ||
+           m_type == Type::Comment || m_type == Type::Array || m_type == Type::GraphOnParent)
+            return -1;
+        return m_instance->watchGui(m_ptr, static_cast<size_t>(m_type));
+    }
+
+    void Gui::unwatch(int index) const noexcept
+    {
+        if(m_ptr && index >= 0)
+        {
+            m_instance->unwatchGui(m_ptr, index);
+        }
+    }
+
+    uint32_t Gui::getPublishedVersion(int index) const noexcept
+    {
+        return m_instance->getGuiVersion(index);
+    }
+
+    float Gui::getPublishedValue(int index) const noexcept
+    {
+        return m_instance->getGuiValue(index);
+    }
     
+    std::string Gui::getPublishedText(int index) const
+    {
+        return m_instance->getGuiText(index);
+    }
+    
+    void Gui::readText(void* ptr, Type type, char* text, size_t size) noexcept
+    {
+        text[0] = '\0';
+        if(type == Type::AtomSymbol)
+        {
+            std::strncpy(text, atom_getsymbol(fake_gatom_getatom(static_cast<t_fake_gatom*>(ptr)))->s_name, size - 1);
+            text[size-1] = '\0';
+        }
+        else if(type == Type::AtomList)
+        {
+            int const ac = binbuf_getnatom(static_cast<t_fake_gatom*>(ptr)->a_text.te_binbuf);
+            t_atom* av = binbuf_getvec(static_cast<t_fake_gatom*>(ptr)->a_text.te_binbuf);
+            size_t length = 0;
+            for(int i = 0; i < ac && length + 1 < size; ++i)
+            {
+                if(i)
+                {
+                    text[length++] = ' ';
+                }
+                atom_string(av+i, text + length, static_cast<unsigned int>(size - length));
+                length += std::strlen(text + length);
+            }
+            text[std::min(length, size - 1)] = '\0';
+        }
+    }
+
+    static uint64_t stampFromFloat(float const value) noexcept
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float Gui::readValue(void* ptr, Type type, uint64_t& stamp) noexcept
+    {
+        if(type == Type::Bang)
+        {
+            // the lowest bit of the stamp is the last state of the flash and the other bits count
+            // the flashes, the object isn't modified so two bangs during the same publication
+            // period are merged
+            bool const flashed = (static_cast<t_bng*>(ptr))->x_flashed > 0;
+            if(flashed != static_cast<bool>(stamp & 1))
+            {
+                stamp = flashed ? (((stamp >> 1) + 1) << 1) | 1 : stamp & ~uint64_t(1);
+            }
+            return flashed ? 1.f : 0.f;
+        }
+        else if(type == Type::AtomSymbol)
+        {
+            stamp = reinterpret_cast<uintptr_t>(atom_getsymbol(fake_gatom_getatom(static_cast<t_fake_gatom*>(ptr))));
+            return 0.f;
+        }
+        else if(type == Type::AtomList)
+        {
+            // FNV-1a of the atoms, the symbols are compared by address
+            int const ac = binbuf_getnatom(static_cast<t_fake_gatom*>(ptr)->a_text.te_binbuf);
+            t_atom const* av = binbuf_getvec(static_cast<t_fake_gatom*>(ptr)->a_text.te_binbuf);
+            uint64_t hash = 14695981039346656037ull ^ static_cast<uint64_t>(ac);
+            for(int i = 0; i < ac; ++i)
+            {
+                uint64_t const word = av[i].a_type == A_FLOAT ? stampFromFloat(av[i].a_w.w_float) :
+                (av[i].a_type == A_SYMBOL ? reinterpret_cast<uintptr_t>(av[i].a_w.w_symbol) : 0);
+                hash = (hash ^ word) * 1099511628211ull;
+            }
+            stamp = hash;
+            return 0.f;
+        }
+
+        float value = 0.f;
+        if(type == Type::HorizontalSlider)
+        {
+            value = (static_cast<t_hslider*>(ptr))->x_fval;
+        }
+        else if(type == Type::VerticalSlider)
+        {
+            value = (static_cast<t_vslider*>(ptr))->x_fval;
+        }
+        else if(type == Type::Toggle)
+        {
+            value = (static_cast<t_toggle*>(ptr))->x_on;
+        }
+        else if(type == Type::Number)
+        {
+            value = (static_cast<t_my_numbox*>(ptr))->x_val;
+        }
+        else if(type == Type::HorizontalRadio)
+        {
+            value = (static_cast<t_hdial*>(ptr))->x_on;
+        }
+        else if(type == Type::VerticalRadio)
+        {
+            value = (static_cast<t_vdial*>(ptr))->x_on;
+        }
+        else if(type == Type::AtomNumber)
+        {
+            value = atom_getfloat(fake_gatom_getatom(static_cast<t_fake_gatom*>(ptr)));
+        }
+        stamp = stampFromFloat(value);
+        return value;
+    }
+
     // ==================================================================================== //
     //                                      LABEL                                           //
     // ==================================================================================== //
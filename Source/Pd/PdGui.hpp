@@ -8,6 +8,7 @@
 #include "PdObject.hpp"
 #include "PdArray.hpp"
 #include "PdAtom.hpp"
+#include <cstdint>
 
 namespace pd
 {
@@ -114,12 +115,41 @@ namespace pd
         Label getLabel() const noexcept;
             
         Patch getPatch() const noexcept;
+        
+        //! @brief Watches the value of the GUI and returns its index in the snapshot table.
+        //! @details The values of the watched GUIs are published by the audio thread after\n
+        //! each DSP tick so they can be read without accessing the Pd object. Returns -1 if\n
+        //! the GUI has no value or if the table of the instance is full.
+        int watch() const noexcept;
+        
+        //! @brief Stops watching the value of the GUI.
+        void unwatch(int index) const noexcept;
+        
+        //! @brief Gets the version of the published value, it changes with the value.
+        uint32_t getPublishedVersion(int index) const noexcept;
+        
+        //! @brief Gets the published value.
+        float getPublishedValue(int index) const noexcept;
+        
+        //! @brief Gets the published text of a symbol or a list GUI.
+        //! @details The atoms of a list are separated by spaces.
+        std::string getPublishedText(int index) const;
     private:
 
         Gui(void* ptr, void* patch, Instance* instance) noexcept;
         
+        //! @brief Reads the value of a Pd GUI, the stamp changes if the state changed.
+        //! @details This method must be called with the Pd lock held, the object isn't modified.
+        static float readValue(void* ptr, Type type, uint64_t& stamp) noexcept;
+        
+        //! @brief Formats the text of a symbol or a list GUI in a buffer.
+        //! @details This method must be called with the Pd lock held, the text is truncated\n
+        //! to the size of the buffer.
+        static void readText(void* ptr, Type type, char* text, size_t size) noexcept;
+        
         Type m_type = Type::Undefined;
         friend class Patch;
+        friend class Instance;
     };
     
     // ==================================================================================== //
@@ -5,7 +5,10 @@
  */
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include "PdInstance.hpp"
 #include "PdPatch.hpp"
 
@@ -14,6 +17,7 @@ extern "C"
 #include <z_libpd.h>
 #include "x_libpd_multi.h"
 #include "x_libpd_extra_utils.h"
+#include "x_libpd_profiler.h"
 }
 
 extern "C"
@@ -120,7 +124,9 @@ namespace pd
     
     Instance::Instance(std::string const& symbol)
     {
-        libpd_multi_init();
+        // the hosts can create the instances on several threads
+        static std::once_flag initialized;
+        std::call_once(initialized, libpd_multi_init);
         m_instance = libpd_new_instance();
         libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
         m_midi_receiver = libpd_multi_midi_new(this,
@@ -141,15 +147,25 @@ namespace pd
                                                       reinterpret_cast<t_libpd_multi_listhook>(internal::instance_multi_list),
                                                       reinterpret_cast<t_libpd_multi_messagehook>(internal::instance_multi_message));
         m_atoms = malloc(sizeof(t_atom) * 512);
+        m_gui_slots = std::make_unique<GuiSlot[]>(gui_table_size);
+        m_gui_used = std::make_unique<int[]>(gui_table_size);
     }
     
     Instance::~Instance()
     {
         closePatch();
+        if(m_profiler)
+        {
+            libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+            libpd_profiler_free(m_profiler);
+        }
+        // the receivers are unbound from the symbols of their instance
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        sys_lock();
         pd_free((t_pd *)m_midi_receiver);
         pd_free((t_pd *)m_print_receiver);
         pd_free((t_pd *)m_message_receiver);
-        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        sys_unlock();
         libpd_free_instance(static_cast<t_pdinstance *>(m_instance));
     }
     
@@ -165,6 +181,8 @@ namespace pd
     {
         libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
         libpd_init_audio(nins, nouts, (int)samplerate);
+        m_gui_period = std::max(static_cast<int>(samplerate / (100. * static_cast<double>(getBlockSize()))), 1);
+        m_gui_countdown = 0;
     }
     
     void Instance::startDSP()
@@ -360,10 +378,14 @@ namespace pd
         }
     }
     
-    void Instance::enqueueMessages(const std::string& dest, const std::string& msg, std::vector<Atom>&& list)
+    bool Instance::enqueueMessages(const std::string& dest, const std::string& msg, std::vector<Atom>&& list)
     {
-        m_send_queue.try_enqueue(dmessage{nullptr, dest, msg, std::move(list)});
-        messageEnqueued();
+        if(m_send_queue.try_enqueue(dmessage{nullptr, dest, msg, std::move(list)}))
+        {
+            messageEnqueued();
+            return true;
+        }
+        return false;
     }
     
     void Instance::enqueueDirectMessages(void* object, const std::string& msg)
@@ -394,21 +416,18 @@ namespace pd
             {
                 if(mess.selector == "list")
                 {
+                    // the lock of the instance is taken once for the symbols and the list
                     t_atom* argv = static_cast<t_atom*>(m_atoms);
+                    sys_lock();
                     for(size_t i = 0; i < mess.list.size(); ++i)
                     {
                         if(mess.list[i].isFloat())
                             SETFLOAT(argv+i, mess.list[i].getFloat());
                         else if(mess.list[i].isSymbol())
-                        {
-                            sys_lock();
                             SETSYMBOL(argv+i, gensym(mess.list[i].getSymbol().data()));
-                            sys_unlock();
-                        }
                         else
                             SETFLOAT(argv+i, 0.0);
                     }
-                    sys_lock();
                     pd_list(static_cast<t_pd *>(mess.object), gensym("list"), static_cast<int>(mess.list.size()), argv);
                     sys_unlock();
                 }
@@ -447,7 +466,19 @@ namespace pd
     {
         if(m_patch)
         {
+            if(m_profiler)
+            {
+                libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+                libpd_profiler_stop(m_profiler);
+            }
             libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+            sys_lock();
+            for(int i = 0; i < m_gui_nused; ++i)
+            {
+                m_gui_slots[m_gui_used[i]].object = nullptr;
+            }
+            m_gui_nused = 0;
+            sys_unlock();
             libpd_closefile(m_patch);
             m_patch = nullptr;
         }
@@ -474,5 +505,182 @@ namespace pd
         libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
     }
     
+    //////////////////////////////////////////////////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    int Instance::watchGui(void* object, size_t type)
+    {
+        int index = -1;
+        bool const text = static_cast<Gui::Type>(type) == Gui::Type::AtomSymbol ||
+        static_cast<Gui::Type>(type) == Gui::Type::AtomList;
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        sys_lock();
+        for(int i = 0; i < gui_table_size; ++i)
+        {
+            GuiSlot& slot = m_gui_slots[i];
+            if(slot.object == nullptr)
+            {
+                if(text && !slot.text)
+                {
+                    slot.text = std::make_unique<char[]>(gui_text_size);
+                }
+                slot.object    = object;
+                slot.type      = type;
+                slot.published = object;
+                slot.value.store(Gui::readValue(object, static_cast<Gui::Type>(type), slot.stamp), std::memory_order_relaxed);
+                if(text)
+                {
+                    slot.sequence.fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_release);
+                    Gui::readText(object, static_cast<Gui::Type>(type), slot.text.get(), gui_text_size);
+                    slot.sequence.fetch_add(1, std::memory_order_release);
+                }
+                slot.version.fetch_add(1, std::memory_order_release);
+                m_gui_used[m_gui_nused] = i;
+                m_gui_nused.fetch_add(1, std::memory_order_relaxed);
+                index = i;
+                break;
+            }
+        }
+        sys_unlock();
+        return index;
+    }
+    
+    void Instance::unwatchGui(void* object, int index)
+    {
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        sys_lock();
+        // the table might have been cleared and the slot reused since the GUI was watched
+        if(index >= 0 && index < gui_table_size && m_gui_slots[index].object == object)
+        {
+            m_gui_slots[index].object = nullptr;
+            int const nused = m_gui_nused;
+            for(int i = 0; i < nused; ++i)
+            {
+                if(m_gui_used[i] == index)
+                {
+                    m_gui_used[i] = m_gui_used[nused-1];
+                    m_gui_nused = nused - 1;
+                    break;
+                }
+            }
+        }
+        sys_unlock();
+    }
+    
+    uint32_t Instance::getGuiVersion(int index) const noexcept
+    {
+        return m_gui_slots[index].version.load(std::memory_order_acquire);
+    }
+    
+    float Instance::getGuiValue(int index) const noexcept
+    {
+        return m_gui_slots[index].value.load(std::memory_order_relaxed);
+    }
+    
+    std::string Instance::getGuiText(int index) const
+    {
+        GuiSlot const& slot = m_gui_slots[index];
+        if(!slot.text)
+        {
+            return std::string();
+        }
+        char text[gui_text_size];
+        while(true)
+        {
+            uint32_t const sequence = slot.sequence.load(std::memory_order_acquire);
+            if(sequence & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::memcpy(text, slot.text.get(), gui_text_size);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot.sequence.load(std::memory_order_relaxed) == sequence)
+            {
+                break;
+            }
+        }
+        text[gui_text_size-1] = '\0';
+        return std::string(text);
+    }
+    
+    void Instance::publishGuis()
+    {
+        if(m_gui_nused.load(std::memory_order_relaxed) == 0 || --m_gui_countdown > 0)
+        {
+            return;
+        }
+        m_gui_countdown = m_gui_period;
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        sys_lock();
+        int const nused = m_gui_nused;
+        for(int i = 0; i < nused; ++i)
+        {
+            GuiSlot& slot = m_gui_slots[m_gui_used[i]];
+            bool const fresh = slot.published != slot.object;
+            uint64_t stamp = slot.stamp;
+            float const value = Gui::readValue(slot.object, static_cast<Gui::Type>(slot.type), stamp);
+            if(fresh || stamp != slot.stamp)
+            {
+                slot.published = slot.object;
+                slot.stamp = stamp;
+                slot.value.store(value, std::memory_order_relaxed);
+                if(slot.text)
+                {
+                    // the text is only formatted when the symbol or the list changed
+                    slot.sequence.fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_release);
+                    Gui::readText(slot.object, static_cast<Gui::Type>(slot.type), slot.text.get(), gui_text_size);
+                    slot.sequence.fetch_add(1, std::memory_order_release);
+                }
+                slot.version.fetch_add(1, std::memory_order_release);
+            }
+        }
+        sys_unlock();
+    }
+    
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    //                                      PROFILER                                        //
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    bool Instance::startProfiler(int nticks)
+    {
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        if(!m_profiler)
+        {
+            m_profiler = libpd_profiler_new();
+        }
+        return m_profiler && libpd_profiler_start(m_profiler, nticks);
+    }
+    
+    int Instance::pollProfiler()
+    {
+        if(!m_profiler)
+        {
+            return -1;
+        }
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        return libpd_profiler_poll(m_profiler);
+    }
+    
+    int Instance::getProfilerReport(std::vector<std::string>& lines)
+    {
+        if(!m_profiler)
+        {
+            return -1;
+        }
+        libpd_set_instance(static_cast<t_pdinstance *>(m_instance));
+        int const state = libpd_profiler_poll(m_profiler);
+        if(state > 0)
+        {
+            lines.clear();
+            libpd_profiler_report(m_profiler, [](void* user, const char* line)
+            {
+                static_cast<std::vector<std::string>*>(user)->push_back(line);
+            }, &lines);
+        }
+        return state;
+    }
 }
-
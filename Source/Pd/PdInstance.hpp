@@ -8,6 +8,8 @@
 
 #include <map>
 #include <utility>
+#include <atomic>
+#include <memory>
 #include "PdPatch.hpp"
 #include "PdAtom.hpp"
 
@@ -67,7 +69,8 @@ namespace pd
         virtual void receiveList(const std::vector<Atom>& list) {}
         virtual void receiveMessage(const std::string& msg, const std::vector<Atom>& list) {}
         
-        void enqueueMessages(const std::string& dest, const std::string& msg, std::vector<Atom>&& list);
+        //! @brief Enqueues a message sent at the next tick, returns false if the queue is full.
+        bool enqueueMessages(const std::string& dest, const std::string& msg, std::vector<Atom>&& list);
         void enqueueDirectMessages(void* object, const std::string& msg);
         void enqueueDirectMessages(void* object, const float msg);
         void enqueueDirectMessages(void* object, std::vector<Atom> const& list);
@@ -86,6 +89,35 @@ namespace pd
         void setThis();
         Array getArray(std::string const& name);
         
+        //! @brief Adds a GUI to the snapshot table and returns its index or -1 if the table is full.
+        int watchGui(void* object, size_t type);
+        //! @brief Removes a GUI from the snapshot table.
+        void unwatchGui(void* object, int index);
+        //! @brief Gets the version of the value of a GUI of the snapshot table.
+        uint32_t getGuiVersion(int index) const noexcept;
+        //! @brief Gets the value of a GUI of the snapshot table.
+        float getGuiValue(int index) const noexcept;
+        //! @brief Gets the text of a symbol or a list GUI of the snapshot table.
+        //! @details The text is copied without lock and read again if the audio thread\n
+        //! published a new text during the copy.
+        std::string getGuiText(int index) const;
+        //! @brief Publishes the values of the GUIs that changed in the snapshot table.
+        //! @details The method must be called by the audio thread after the DSP tick. The GUIs\n
+        //! are only read, and only every gui_period ticks (about 100 times per second, faster\n
+        //! than the editor polls them), the other calls return immediately.
+        void publishGuis();
+        
+        //! @brief Starts to profile the perform routines of the DSP chain during a number of ticks.
+        //! @details Returns false if the DSP is off.
+        bool startProfiler(int nticks);
+        //! @brief Gets if the profiler is done (1), running (0) or stopped (-1).
+        //! @details The method doesn't allocate and can be called by the audio thread.
+        int pollProfiler();
+        //! @brief Gets the report of the profiler.
+        //! @details Returns 1 and fills the lines when the profiler is done, 0 while it runs\n
+        //! and -1 if it has been stopped (the DSP chain has been rebuilt) or never started.
+        int getProfilerReport(std::vector<std::string>& lines);
+        
     private:
     
         void* m_instance            = nullptr;
@@ -94,6 +126,7 @@ namespace pd
         void* m_message_receiver    = nullptr;
         void* m_midi_receiver       = nullptr;
         void* m_print_receiver      = nullptr;
+        void* m_profiler            = nullptr;
         
         struct Message
         {
@@ -126,6 +159,32 @@ namespace pd
             int  midi3;
         } midievent;
         
+        //! @brief A GUI of the snapshot table.
+        //! @details The object and the type are only accessed with the Pd lock held, the\n
+        //! value and the version are read by the editor without lock. The text of the symbol\n
+        //! and list GUIs is protected by a sequence that is odd while the text is written.
+        struct GuiSlot
+        {
+            void*                   object    = nullptr;
+            size_t                  type      = 0;
+            void*                   published = nullptr;
+            uint64_t                stamp     = 0;
+            std::atomic<float>      value     {0.f};
+            std::atomic<uint32_t>   version   {0};
+            std::unique_ptr<char[]> text;
+            std::atomic<uint32_t>   sequence  {0};
+        };
+        
+        static const int gui_table_size = 1024;
+        static const size_t gui_text_size = 256;
+        std::unique_ptr<GuiSlot[]> m_gui_slots;
+        //! @brief The indices of the slots in use, so only these slots are published.
+        std::unique_ptr<int[]>     m_gui_used;
+        std::atomic<int>           m_gui_nused {0};
+        //! @brief The number of ticks between two publications and the ticks left until the next one.
+        int                        m_gui_period    = 1;
+        int                        m_gui_countdown = 0;
+        
         typedef moodycamel::ConcurrentQueue<dmessage> message_queue;
         message_queue m_send_queue = message_queue(4096);
         
@@ -86,6 +86,11 @@ namespace pd
     {
         return m_ptr != other.m_ptr;
     }
+    
+    void const* Object::getId() const noexcept
+    {
+        return m_ptr;
+    }
 }
 
 
@@ -40,6 +40,10 @@ namespace pd
         //! @brief The compare unequal operator.
         bool operator!=(Object const& other) const noexcept;
         
+        //! @brief The unique identifier of the Object.
+        //! @details The identifier is the address of the Pd object, it can be used as a key.
+        void const* getId() const noexcept;
+        
         //! @brief The destructor.
         virtual ~Object() noexcept = default;
         
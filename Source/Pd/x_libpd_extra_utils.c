@@ -5,10 +5,19 @@
  */
 
 #include "x_libpd_multi.h"
+#include "x_libpd_patch_cache.h"
 #include <m_pd.h>
 #include <m_imp.h>
 #include <g_canvas.h>
 #include <g_all_guis.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 // False GARRAY
 typedef struct _fake_garray
@@ -26,10 +35,19 @@ typedef struct _fake_garray
 
 void* libpd_create_canvas(const char* name, const char* path)
 {
-    t_canvas* cnv = (t_canvas *)libpd_openfile(name, path);
+    void* patch = NULL;
+    t_canvas* cnv;
+    // the file is only opened from the disk if the cache can't read it
+    if(!libpd_patch_cache_openfile(name, path, &patch))
+    {
+        patch = libpd_openfile(name, path);
+    }
+    cnv = (t_canvas *)patch;
     if(cnv)
     {
+        sys_lock();
         canvas_vis(cnv, 1.f);
+        sys_unlock();
     }
     return cnv;
 }
@@ -69,7 +87,9 @@ char const* libpd_array_get_name(void* ptr)
 void libpd_array_get_scale(char const* name, float* min, float* max)
 {
     t_canvas const *cnv;
-    t_fake_garray const *array = libpd_array_get_byname(name);
+    t_fake_garray const *array;
+    sys_lock();
+    array = libpd_array_get_byname(name);
     if(array)
     {
         cnv = ((t_fake_garray*)array)->x_glist;
@@ -77,16 +97,18 @@ void libpd_array_get_scale(char const* name, float* min, float* max)
         {
             *min = cnv->gl_y2;
             *max = cnv->gl_y1;
+            sys_unlock();
             return;
         }
     }
+    sys_unlock();
     *min = -1;
     *max = 1;
 }
 
-int libpd_array_get_style(char const* name)
+// Gets the style of an array, the instance must be locked
+static int libpd_array_get_style_locked(t_fake_garray const* array)
 {
-    t_fake_garray const *array = libpd_array_get_byname(name);
     if(array && array->x_scalar)
     {
         t_scalar *scalar = array->x_scalar;
@@ -99,8 +121,365 @@ int libpd_array_get_style(char const* name)
     return 0;
 }
 
+int libpd_array_get_style(char const* name)
+{
+    int style;
+    sys_lock();
+    style = libpd_array_get_style_locked(libpd_array_get_byname(name));
+    sys_unlock();
+    return style;
+}
+
+// Gets a new validity stamp for the arrays. The counter of Pd is shared by all the instances
+// that are locked separately, the increment is atomic so two swaps never race but Pd
+// increments the counter itself without atomics (++glist_valid when a patch is edited or an
+// array is resized), so a swap can still race with an instance that does so. The race is
+// only fixed if the increments of Pd are made atomic or global, taking pd_globallock() here
+// isn't possible because the instance is already locked. A lost increment can only reuse a
+// stamp and make an object keep a pointer to a previous vector, so the swaps should not be
+// made while another instance loads or edits a patch.
+static int libpd_array_next_valid(void)
+{
+#ifdef _MSC_VER
+    return (int)_InterlockedIncrement((long volatile *)&glist_valid);
+#else
+    return __atomic_add_fetch(&glist_valid, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+// Gets the size of a value in the vector of an array (larger than a float on 64-bit)
+int libpd_array_word_size(void)
+{
+    return (int)sizeof(t_word);
+}
+
+// Allocates and fills a vector that can replace the vector of an array
+void* libpd_array_allocate(float const* values, int size)
+{
+    int i;
+    t_word* vec = (t_word *)getbytes(sizeof(t_word) * (size_t)(size > 0 ? size : 1));
+    if(vec)
+    {
+        for(i = 0; i < size; ++i)
+        {
+            vec[i].w_float = values[i];
+        }
+    }
+    return vec;
+}
+
+void libpd_array_free(void* vec, int size)
+{
+    freebytes(vec, sizeof(t_word) * (size_t)(size > 0 ? size : 1));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// The vectors shared by the instances (the mapped files) aren't allocated by Pd so they must
+// never be freed or reallocated by Pd. The vectors are recorded with the number of arrays
+// that use them and the swap and the resize of these arrays are refused. The registry is
+// shared by all the instances so it has a lock of its own.
+
+typedef struct _libpd_shared_vector
+{
+    void*   s_vec;
+    int     s_count;
+} t_libpd_shared_vector;
+
+static t_libpd_shared_vector* libpd_shared_vectors = NULL;
+static int libpd_shared_nvectors = 0;
+#ifdef _WIN32
+static SRWLOCK libpd_shared_mutex = SRWLOCK_INIT;
+#define libpd_shared_lock() AcquireSRWLockExclusive(&libpd_shared_mutex)
+#define libpd_shared_unlock() ReleaseSRWLockExclusive(&libpd_shared_mutex)
+#else
+static pthread_mutex_t libpd_shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define libpd_shared_lock() pthread_mutex_lock(&libpd_shared_mutex)
+#define libpd_shared_unlock() pthread_mutex_unlock(&libpd_shared_mutex)
+#endif
+
+static int libpd_array_is_shared(void const* vec)
+{
+    int i, shared = 0;
+    libpd_shared_lock();
+    for(i = 0; i < libpd_shared_nvectors && !shared; ++i)
+    {
+        shared = libpd_shared_vectors[i].s_vec == vec;
+    }
+    libpd_shared_unlock();
+    return shared;
+}
+
+static int libpd_array_register(void* vec)
+{
+    int i;
+    t_libpd_shared_vector* temp;
+    libpd_shared_lock();
+    for(i = 0; i < libpd_shared_nvectors; ++i)
+    {
+        if(libpd_shared_vectors[i].s_vec == vec)
+        {
+            libpd_shared_vectors[i].s_count++;
+            libpd_shared_unlock();
+            return 0;
+        }
+    }
+    temp = (t_libpd_shared_vector *)resizebytes(libpd_shared_vectors,
+                                                sizeof(t_libpd_shared_vector) * (size_t)libpd_shared_nvectors,
+                                                sizeof(t_libpd_shared_vector) * (size_t)(libpd_shared_nvectors + 1));
+    if(!temp)
+    {
+        libpd_shared_unlock();
+        return -1;
+    }
+    libpd_shared_vectors = temp;
+    libpd_shared_vectors[libpd_shared_nvectors].s_vec = vec;
+    libpd_shared_vectors[libpd_shared_nvectors].s_count = 1;
+    libpd_shared_nvectors++;
+    libpd_shared_unlock();
+    return 0;
+}
+
+static void libpd_array_unregister(void* vec)
+{
+    int i;
+    libpd_shared_lock();
+    for(i = 0; i < libpd_shared_nvectors; ++i)
+    {
+        if(libpd_shared_vectors[i].s_vec == vec)
+        {
+            // the registry is never shrunk, the last entry replaces the removed one
+            if(--libpd_shared_vectors[i].s_count == 0)
+            {
+                libpd_shared_vectors[i] = libpd_shared_vectors[--libpd_shared_nvectors];
+            }
+            break;
+        }
+    }
+    libpd_shared_unlock();
+}
+
+// The versions of the arrays are incremented each time Camomile writes, swaps or resizes an
+// array so the readers can skip the arrays that didn't change. The objects of Pd that write
+// the vectors directly (tabwrite~, array set...) don't increment the version. The table is
+// indexed by the address of the arrays and shares the lock of the shared vectors. When the
+// table is full, the arrays that aren't recorded get a new version at each request.
+
+#define LIBPD_ARRAY_NVERSIONS 1024
 
+typedef struct _libpd_array_version
+{
+    void const*     v_array;
+    unsigned int    v_version;
+} t_libpd_array_version;
+
+static t_libpd_array_version libpd_array_versions[LIBPD_ARRAY_NVERSIONS];
+static unsigned int libpd_array_untracked = 0;
+
+static t_libpd_array_version* libpd_array_get_version_entry(void const* array)
+{
+    size_t i;
+    size_t const hash = ((size_t)array >> 4) * 2654435761u;
+    for(i = 0; i < LIBPD_ARRAY_NVERSIONS; ++i)
+    {
+        t_libpd_array_version* entry = libpd_array_versions + (hash + i) % LIBPD_ARRAY_NVERSIONS;
+        if(entry->v_array == array)
+        {
+            return entry;
+        }
+        if(entry->v_array == NULL)
+        {
+            entry->v_array = array;
+            entry->v_version = 0;
+            return entry;
+        }
+    }
+    return NULL;
+}
 
+static void libpd_array_touch_locked(void const* array)
+{
+    t_libpd_array_version* entry;
+    libpd_shared_lock();
+    entry = libpd_array_get_version_entry(array);
+    if(entry)
+    {
+        entry->v_version++;
+    }
+    libpd_shared_unlock();
+}
+
+void libpd_array_touch(char const* name)
+{
+    t_fake_garray* array;
+    sys_lock();
+    array = libpd_array_get_byname(name);
+    if(array)
+    {
+        libpd_array_touch_locked(array);
+    }
+    sys_unlock();
+}
+
+int libpd_array_get_version(char const* name, unsigned int* version)
+{
+    t_fake_garray* array;
+    t_libpd_array_version* entry;
+    int size = -1;
+    sys_lock();
+    array = libpd_array_get_byname(name);
+    if(array)
+    {
+        size = garray_npoints((t_garray *)array);
+        libpd_shared_lock();
+        entry = libpd_array_get_version_entry(array);
+        *version = entry ? entry->v_version : ++libpd_array_untracked;
+        libpd_shared_unlock();
+    }
+    sys_unlock();
+    return size;
+}
+
+// Replaces the vector of an array, the lock must be acquired
+static int libpd_array_swap_locked(t_fake_garray* array, void* vec, int size, void** oldvec, int* oldsize)
+{
+    t_array* data;
+    t_glist* gl;
+    if(!array || size < 1)
+    {
+        return -1;
+    }
+    data = garray_getarray((t_garray *)array);
+    if(data->a_elemsize != sizeof(t_word))
+    {
+        return -1;
+    }
+    *oldvec = data->a_vec;
+    *oldsize = data->a_n;
+    data->a_vec = (char *)vec;
+    data->a_n = size;
+    data->a_valid = libpd_array_next_valid();
+    libpd_array_touch_locked(array);
+    gl = array->x_glist;
+    if(gl && gl->gl_list == &array->x_gobj && !array->x_gobj.g_next)
+    {
+        int const style = libpd_array_get_style_locked(array);
+        vmess(&gl->gl_pd, gensym("bounds"), "ffff", 0., gl->gl_y1,
+              (double)(style == 0 || size == 1 ? size : size - 1), gl->gl_y2);
+    }
+    garray_redraw((t_garray *)array);
+    if(array->x_usedindsp)
+    {
+        canvas_update_dsp();
+    }
+    return 0;
+}
+
+// Replaces the vector of an array (the array is resized without allocation or copy) and
+// returns the previous vector, the pointers to the array are invalidated as when the array
+// is resized. The cost isn't constant: the array is redrawn and the DSP chain is rebuilt if
+// the array is used by the DSP.
+// The swap is refused if the array uses a shared vector (returns -2).
+int libpd_array_swap(char const* name, void* vec, int size, void** oldvec, int* oldsize)
+{
+    t_fake_garray* array;
+    int result;
+    sys_lock();
+    array = libpd_array_get_byname(name);
+    if(array && libpd_array_is_shared(garray_getarray((t_garray *)array)->a_vec))
+    {
+        sys_unlock();
+        return -2;
+    }
+    result = libpd_array_swap_locked(array, vec, size, oldvec, oldsize);
+    sys_unlock();
+    return result;
+}
+
+// Replaces the vector of an array by a shared vector that Pd must never free or reallocate
+// and returns the previous vector that must be restored with libpd_array_unshare()
+int libpd_array_share(char const* name, void* vec, int size, void** oldvec, int* oldsize)
+{
+    t_fake_garray* array;
+    int result;
+    sys_lock();
+    array = libpd_array_get_byname(name);
+    if(array && libpd_array_is_shared(garray_getarray((t_garray *)array)->a_vec))
+    {
+        sys_unlock();
+        return -2;
+    }
+    if(libpd_array_register(vec))
+    {
+        sys_unlock();
+        return -1;
+    }
+    result = libpd_array_swap_locked(array, vec, size, oldvec, oldsize);
+    if(result)
+    {
+        libpd_array_unregister(vec);
+    }
+    sys_unlock();
+    return result;
+}
+
+// Restores the vector of an array replaced by libpd_array_share()
+int libpd_array_unshare(char const* name, void* vec, int size)
+{
+    t_fake_garray* array;
+    void* sharedvec = NULL;
+    int sharedsize = 0, result;
+    sys_lock();
+    array = libpd_array_get_byname(name);
+    result = libpd_array_swap_locked(array, vec, size, &sharedvec, &sharedsize);
+    if(!result)
+    {
+        libpd_array_unregister(sharedvec);
+    }
+    sys_unlock();
+    return result;
+}
+
+// Returns 1 if an array uses a shared vector, the shared vectors are mapped read-only so the
+// values can't be written, -1 if the array doesn't exist
+int libpd_array_is_readonly(char const* name)
+{
+    t_fake_garray* array;
+    int result = -1;
+    sys_lock();
+    array = libpd_array_get_byname(name);
+    if(array)
+    {
+        result = libpd_array_is_shared(garray_getarray((t_garray *)array)->a_vec);
+    }
+    sys_unlock();
+    return result;
+}
+
+// Replaces the "resize" method of the arrays to refuse the resize of the arrays that use a
+// shared vector (the previous method is renamed "resize_aliased" by Pd). The properties
+// dialog and the objects that call garray_resize_long() directly ([array size] and
+// soundfiler -resize) aren't guarded, and an array must not be deleted while it's shared.
+static void libpd_array_resize(t_garray* x, t_floatarg f)
+{
+    if(libpd_array_is_shared(garray_getarray(x)->a_vec))
+    {
+        pd_error(x, "%s: can't resize a shared array", ((t_fake_garray *)x)->x_realname->s_name);
+        return;
+    }
+    garray_resize_long(x, (long)f);
+    libpd_array_touch_locked(x);
+}
+
+void libpd_array_setup(void)
+{
+    pd_globallock();
+    class_addmethod(garray_class, (t_method)libpd_array_resize, gensym("resize"), A_FLOAT, 0);
+    pd_globalunlock();
+}
 
 static unsigned int convert_from_iem_color(int const color)
 {
@@ -23,6 +23,16 @@ extern "C"
     char const* libpd_array_get_name(void* ptr);
     void libpd_array_get_scale(char const* name, float* min, float* max);
     int libpd_array_get_style(char const* name);
+    void libpd_array_touch(char const* name);
+    int libpd_array_get_version(char const* name, unsigned int* version);
+    int libpd_array_word_size(void);
+    void* libpd_array_allocate(float const* values, int size);
+    void libpd_array_free(void* vec, int size);
+    int libpd_array_swap(char const* name, void* vec, int size, void** oldvec, int* oldsize);
+    int libpd_array_share(char const* name, void* vec, int size, void** oldvec, int* oldsize);
+    int libpd_array_unshare(char const* name, void* vec, int size);
+    int libpd_array_is_readonly(char const* name);
+    void libpd_array_setup(void);
     
     unsigned int libpd_iemgui_get_background_color(void* ptr);
     unsigned int libpd_iemgui_get_foreground_color(void* ptr);
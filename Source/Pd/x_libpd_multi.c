@@ -7,6 +7,8 @@
 #include <m_pd.h>
 #include <s_net.h>
 #include "x_libpd_multi.h"
+#include "x_libpd_patch_cache.h"
+#include "x_libpd_extra_utils.h"
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -65,7 +67,7 @@ static void libpd_multi_receiver_free(t_libpd_multi_receiver *x)
 
 static void libpd_multi_receiver_setup(void)
 {
-    sys_lock();
+    pd_globallock();
     libpd_multi_receiver_class = class_new(gensym("libpd_multi_receiver"), (t_newmethod)NULL, (t_method)libpd_multi_receiver_free,
                                            sizeof(t_libpd_multi_receiver), CLASS_DEFAULT, A_NULL, 0);
     class_addbang(libpd_multi_receiver_class, libpd_multi_receiver_bang);
@@ -73,7 +75,7 @@ static void libpd_multi_receiver_setup(void)
     class_addsymbol(libpd_multi_receiver_class, libpd_multi_receiver_symbol);
     class_addlist(libpd_multi_receiver_class, libpd_multi_receiver_list);
     class_addanything(libpd_multi_receiver_class, libpd_multi_receiver_anything);
-    sys_unlock();
+    pd_globalunlock();
 }
 
 void* libpd_multi_receiver_new(void* ptr, char const *s,
@@ -87,16 +89,16 @@ void* libpd_multi_receiver_new(void* ptr, char const *s,
     t_libpd_multi_receiver *x = (t_libpd_multi_receiver *)pd_new(libpd_multi_receiver_class);
     if(x)
     {
-        sys_lock();
-        x->x_sym = gensym(s);
-        sys_unlock();
-        pd_bind(&x->x_obj.ob_pd, x->x_sym);
         x->x_ptr = ptr;
         x->x_hook_bang = hook_bang;
         x->x_hook_float = hook_float;
         x->x_hook_symbol = hook_symbol;
         x->x_hook_list = hook_list;
         x->x_hook_message = hook_message;
+        sys_lock();
+        x->x_sym = gensym(s);
+        pd_bind(&x->x_obj.ob_pd, x->x_sym);
+        sys_unlock();
     }
     return x;
 }
@@ -192,10 +194,10 @@ static void libpd_multi_midi_free(t_libpd_multi_midi *x)
 
 static void libpd_multi_midi_setup(void)
 {
-    sys_lock();
+    pd_globallock();
     libpd_multi_midi_class = class_new(gensym("libpd_multi_midi"), (t_newmethod)NULL, (t_method)libpd_multi_midi_free,
                                        sizeof(t_libpd_multi_midi), CLASS_DEFAULT, A_NULL, 0);
-    sys_unlock();
+    pd_globalunlock();
 }
 
 void* libpd_multi_midi_new(void* ptr,
@@ -211,10 +213,6 @@ void* libpd_multi_midi_new(void* ptr,
     t_libpd_multi_midi *x = (t_libpd_multi_midi *)pd_new(libpd_multi_midi_class);
     if(x)
     {
-        sys_lock();
-        t_symbol* s = gensym("#libpd_multi_midi");
-        sys_unlock();
-        pd_bind(&x->x_obj.ob_pd, s);
         x->x_ptr = ptr;
         x->x_hook_noteon        = hook_noteon;
         x->x_hook_controlchange = hook_controlchange;
@@ -223,6 +221,9 @@ void* libpd_multi_midi_new(void* ptr,
         x->x_hook_aftertouch    = hook_aftertouch;
         x->x_hook_polyaftertouch= hook_polyaftertouch;
         x->x_hook_midibyte      = hook_midibyte;
+        sys_lock();
+        pd_bind(&x->x_obj.ob_pd, gensym("#libpd_multi_midi"));
+        sys_unlock();
     }
     return x;
 }
@@ -252,10 +253,10 @@ static void libpd_multi_print(const char* message)
 
 static void libpd_multi_print_setup(void)
 {
-    sys_lock();
+    pd_globallock();
     libpd_multi_print_class = class_new(gensym("libpd_multi_print"), (t_newmethod)NULL, (t_method)NULL,
                                        sizeof(t_libpd_multi_print), CLASS_DEFAULT, A_NULL, 0);
-    sys_unlock();
+    pd_globalunlock();
 }
 
 void* libpd_multi_print_new(void* ptr, t_libpd_multi_printhook hook_print)
@@ -264,12 +265,11 @@ void* libpd_multi_print_new(void* ptr, t_libpd_multi_printhook hook_print)
     t_libpd_multi_print *x = (t_libpd_multi_print *)pd_new(libpd_multi_print_class);
     if(x)
     {
-        sys_lock();
-        t_symbol* s = gensym("#libpd_multi_print");
-        sys_unlock();
-        pd_bind(&x->x_obj.ob_pd, s); 
         x->x_ptr = ptr;
         x->x_hook = hook_print;
+        sys_lock();
+        pd_bind(&x->x_obj.ob_pd, gensym("#libpd_multi_print"));
+        sys_unlock();
     }
     return x;
 }
@@ -281,7 +281,7 @@ void* libpd_multi_print_new(void* ptr, t_libpd_multi_printhook hook_print)
 //
 
 // font char metric triples: pointsize width(pixels) height(pixels)
-static int defaultfontshit[] = {
+static const int defaultfontshit[] = {
     8,  5,  11,  10, 6,  13,  12, 7,  16,  16, 10, 19,  24, 14, 29,  36, 22, 44,
     16, 10, 22,  20, 12, 26,  24, 14, 32,  32, 20, 38,  48, 28, 58,  72, 44, 88
 }; // normal & zoomed (2x)
@@ -307,6 +307,12 @@ static void libpd_defaultfont_init(void)
 
 void pd_tilde_setup(void);
 
+// With PDINSTANCE, sys_lock() only locks the current instance (and the global lock in read
+// mode) so the instances processed by different threads don't wait for each other. The
+// classes are shared by all the instances and they are created with the global lock. The
+// hooks of libpd are global but they only dispatch to the receivers bound in the symbols
+// table of the current instance. The function isn't thread-safe, the caller must ensure
+// that it's called once before any instance is created.
 void libpd_multi_init(void)
 {
     static int initialized = 0;
@@ -326,7 +332,9 @@ void libpd_multi_init(void)
         pd_tilde_setup();
         libpd_multi_receiver_setup();
         libpd_multi_midi_setup();
+        libpd_patch_cache_setup();
         libpd_multi_print_setup();
+        libpd_array_setup();
         libpd_defaultfont_init();
         libpd_set_verbose(4);
         
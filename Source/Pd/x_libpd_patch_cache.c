@@ -0,0 +1,385 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "x_libpd_patch_cache.h"
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+void glob_setfilename(void *dummy, t_symbol *filesym, t_symbol *dirsym);
+void pd_doloadbang(void);
+void class_set_extern_dir(t_symbol *s);
+int pd_setloadingabstraction(t_symbol *sym);
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// With PDINSTANCE, each instance owns its symbols table so the cache can't keep the
+// t_symbol pointers of the instance that parsed the file. The symbols are stored as
+// strings and they are created again in the current instance when the binbuf is built.
+// The cache is shared by all the instances but sys_lock() only locks the current instance,
+// so the cache has a lock of its own. The lock is released before the binbuf is evaluated
+// because the evaluation can create abstractions that use the cache.
+
+typedef struct _libpd_cache_atom
+{
+    t_atomtype  c_type;
+    t_float     c_float;
+    size_t      c_name;
+} t_libpd_cache_atom;
+
+typedef struct _libpd_cache_entry
+{
+    char*                       c_path;
+    time_t                      c_mtime;
+    off_t                       c_size;
+    int                         c_natoms;
+    t_libpd_cache_atom*         c_atoms;
+    char*                       c_names;
+    size_t                      c_nnames;
+    struct _libpd_cache_entry*  c_next;
+} t_libpd_cache_entry;
+
+static t_libpd_cache_entry* libpd_patch_cache = NULL;
+#ifdef _WIN32
+static SRWLOCK libpd_patch_cache_mutex = SRWLOCK_INIT;
+#define libpd_patch_cache_lock() AcquireSRWLockExclusive(&libpd_patch_cache_mutex)
+#define libpd_patch_cache_unlock() ReleaseSRWLockExclusive(&libpd_patch_cache_mutex)
+#else
+static pthread_mutex_t libpd_patch_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define libpd_patch_cache_lock() pthread_mutex_lock(&libpd_patch_cache_mutex)
+#define libpd_patch_cache_unlock() pthread_mutex_unlock(&libpd_patch_cache_mutex)
+#endif
+
+static void libpd_patch_cache_clear(t_libpd_cache_entry* entry)
+{
+    freebytes(entry->c_atoms, (size_t)entry->c_natoms * sizeof(t_libpd_cache_atom));
+    freebytes(entry->c_names, entry->c_nnames);
+    entry->c_atoms  = NULL;
+    entry->c_natoms = 0;
+    entry->c_names  = NULL;
+    entry->c_nnames = 0;
+}
+
+static int libpd_patch_cache_parse(t_libpd_cache_entry* entry, const char* name, const char* dir)
+{
+    int i, natoms;
+    t_atom* vec;
+    size_t nnames = 0;
+    t_binbuf* b = binbuf_new();
+    if(binbuf_read(b, name, dir, 0))
+    {
+        binbuf_free(b);
+        return 0;
+    }
+    natoms = binbuf_getnatom(b);
+    vec = binbuf_getvec(b);
+    for(i = 0; i < natoms; ++i)
+    {
+        if(vec[i].a_type == A_SYMBOL || vec[i].a_type == A_DOLLSYM)
+        {
+            nnames += strlen(vec[i].a_w.w_symbol->s_name) + 1;
+        }
+    }
+    entry->c_atoms  = (t_libpd_cache_atom *)getbytes((size_t)natoms * sizeof(t_libpd_cache_atom));
+    entry->c_names  = (char *)getbytes(nnames);
+    entry->c_natoms = natoms;
+    entry->c_nnames = nnames;
+    nnames = 0;
+    for(i = 0; i < natoms; ++i)
+    {
+        t_libpd_cache_atom* atom = entry->c_atoms+i;
+        atom->c_type  = vec[i].a_type;
+        atom->c_float = 0;
+        atom->c_name  = 0;
+        if(vec[i].a_type == A_FLOAT)
+        {
+            atom->c_float = vec[i].a_w.w_float;
+        }
+        else if(vec[i].a_type == A_DOLLAR)
+        {
+            atom->c_float = (t_float)vec[i].a_w.w_index;
+        }
+        else if(vec[i].a_type == A_SYMBOL || vec[i].a_type == A_DOLLSYM)
+        {
+            size_t const size = strlen(vec[i].a_w.w_symbol->s_name) + 1;
+            memcpy(entry->c_names+nnames, vec[i].a_w.w_symbol->s_name, size);
+            atom->c_name = nnames;
+            nnames += size;
+        }
+    }
+    binbuf_free(b);
+    return 1;
+}
+
+static t_binbuf* libpd_patch_cache_instantiate(t_libpd_cache_entry const* entry)
+{
+    int i;
+    t_binbuf* b = binbuf_new();
+    t_atom* vec = (t_atom *)getbytes((size_t)entry->c_natoms * sizeof(t_atom));
+    for(i = 0; i < entry->c_natoms; ++i)
+    {
+        t_libpd_cache_atom const* atom = entry->c_atoms+i;
+        if(atom->c_type == A_FLOAT) {
+            SETFLOAT(vec+i, atom->c_float); }
+        else if(atom->c_type == A_SYMBOL) {
+            SETSYMBOL(vec+i, gensym(entry->c_names+atom->c_name)); }
+        else if(atom->c_type == A_DOLLSYM) {
+            SETDOLLSYM(vec+i, gensym(entry->c_names+atom->c_name)); }
+        else if(atom->c_type == A_DOLLAR) {
+            SETDOLLAR(vec+i, (int)atom->c_float); }
+        else if(atom->c_type == A_SEMI) {
+            SETSEMI(vec+i); }
+        else if(atom->c_type == A_COMMA) {
+            SETCOMMA(vec+i); }
+        else {
+            SETFLOAT(vec+i, 0); }
+    }
+    binbuf_add(b, entry->c_natoms, vec);
+    freebytes(vec, (size_t)entry->c_natoms * sizeof(t_atom));
+    return b;
+}
+
+//! @brief Gets a new binbuf with the content of the file, the caller must free it.
+static t_binbuf* libpd_patch_cache_get(const char* name, const char* dir)
+{
+    char path[MAXPDSTRING];
+    struct stat st;
+    t_libpd_cache_entry* entry;
+    t_binbuf* b;
+    snprintf(path, MAXPDSTRING, "%s/%s", dir, name);
+    if(stat(path, &st) != 0)
+    {
+        return NULL;
+    }
+    libpd_patch_cache_lock();
+    for(entry = libpd_patch_cache; entry; entry = entry->c_next)
+    {
+        if(!strcmp(entry->c_path, path))
+        {
+            break;
+        }
+    }
+    if(entry && (entry->c_mtime != st.st_mtime || entry->c_size != st.st_size || !entry->c_atoms))
+    {
+        libpd_patch_cache_clear(entry);
+        if(!libpd_patch_cache_parse(entry, name, dir))
+        {
+            libpd_patch_cache_unlock();
+            return NULL;
+        }
+        entry->c_mtime = st.st_mtime;
+        entry->c_size  = st.st_size;
+    }
+    else if(!entry)
+    {
+        entry = (t_libpd_cache_entry *)getbytes(sizeof(t_libpd_cache_entry));
+        if(!libpd_patch_cache_parse(entry, name, dir))
+        {
+            freebytes(entry, sizeof(t_libpd_cache_entry));
+            libpd_patch_cache_unlock();
+            return NULL;
+        }
+        entry->c_path = (char *)getbytes(strlen(path) + 1);
+        strcpy(entry->c_path, path);
+        entry->c_mtime = st.st_mtime;
+        entry->c_size  = st.st_size;
+        entry->c_next  = libpd_patch_cache;
+        libpd_patch_cache = entry;
+    }
+    b = libpd_patch_cache_instantiate(entry);
+    libpd_patch_cache_unlock();
+    return b;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// Vanilla resolves the abstractions after the externals with canvas_open() that opens the
+// file, so the abstractions are resolved ahead of vanilla by the "anything" method of the
+// object maker (the method called when a class doesn't exist). Only the directory of the
+// canvas is searched with stat(): the canvases with declared paths ([declare -path]) and
+// the abstractions of the search paths are left to vanilla to keep the order of the search.
+// An abstraction of the directory of the canvas is preferred to an external with the same
+// name.
+
+static t_anymethod libpd_patch_cache_new_anything = NULL;
+
+// Gets if the canvas or one of its owners has declared paths
+static int libpd_patch_cache_has_paths(t_canvas* canvas)
+{
+    t_canvas* y;
+    for(y = canvas; y; y = y->gl_owner)
+    {
+        if(y->gl_env && y->gl_env->ce_path)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Finds the abstraction in the directory of the canvas (name.pd or name/name.pd)
+static int libpd_patch_cache_find(t_canvas* canvas, const char* classname, char* dir, char* name)
+{
+    char path[MAXPDSTRING];
+    struct stat st;
+    char const* root;
+    if(!canvas || libpd_patch_cache_has_paths(canvas))
+    {
+        return 0;
+    }
+    root = canvas_getdir(canvas)->s_name;
+    snprintf(name, MAXPDSTRING, "%s.pd", classname);
+    snprintf(dir, MAXPDSTRING, "%s", root);
+    snprintf(path, MAXPDSTRING, "%s/%s", dir, name);
+    if(stat(path, &st) == 0)
+    {
+        return 1;
+    }
+    snprintf(dir, MAXPDSTRING, "%s/%s", root, classname);
+    snprintf(path, MAXPDSTRING, "%s/%s", dir, name);
+    return stat(path, &st) == 0;
+}
+
+// Same as do_create_abstraction() but the binbuf comes from the cache instead of the disk.
+// The class is shared by all the canvases so the abstraction is resolved again from the
+// current canvas and the disk is only searched if the cache doesn't find it.
+static t_pd* libpd_patch_cache_create_abstraction(t_symbol* s, int argc, t_atom* argv)
+{
+    char dirbuf[MAXPDSTRING], namebuf[MAXPDSTRING], classslashclass[MAXPDSTRING], *nameptr = namebuf;
+    t_canvas* canvas = canvas_getcurrent();
+    t_pd* was = s__X.s_thing;
+    t_binbuf* b = NULL;
+    int fd;
+
+    if(libpd_patch_cache_find(canvas, s->s_name, dirbuf, namebuf))
+    {
+        b = libpd_patch_cache_get(namebuf, dirbuf);
+    }
+    if(!b)
+    {
+        snprintf(classslashclass, MAXPDSTRING, "%s/%s", s->s_name, s->s_name);
+        if((fd = canvas_open(canvas, s->s_name, ".pd", dirbuf, &nameptr, MAXPDSTRING, 0)) < 0 &&
+           (fd = canvas_open(canvas, classslashclass, ".pd", dirbuf, &nameptr, MAXPDSTRING, 0)) < 0)
+        {
+            return 0;
+        }
+        sys_close(fd);
+    }
+    if(pd_setloadingabstraction(s))
+    {
+        pd_error(0, "%s: can't load abstraction within itself\n", s->s_name);
+        if(b)
+        {
+            binbuf_free(b);
+        }
+        return 0;
+    }
+    canvas_setargs(argc, argv);
+    if(b)
+    {
+        int const dspstate = canvas_suspend_dsp();
+        glob_setfilename(0, gensym(nameptr), gensym(dirbuf));
+        binbuf_eval(b, 0, 0, 0);
+        glob_setfilename(0, &s_, &s_);
+        canvas_resume_dsp(dspstate);
+        binbuf_free(b);
+    }
+    else
+    {
+        binbuf_evalfile(gensym(nameptr), gensym(dirbuf));
+    }
+    if(s__X.s_thing != was)
+    {
+        canvas_popabstraction((t_canvas *)(s__X.s_thing));
+    }
+    else
+    {
+        s__X.s_thing = was;
+    }
+    canvas_setargs(0, 0);
+    return pd_newest();
+}
+
+// Creates the class of the abstraction if it's found in the directory of the canvas, then
+// the object is created by the class, otherwise vanilla resolves the object
+static void libpd_patch_cache_anything(t_pd* x, t_symbol* s, int argc, t_atom* argv)
+{
+    char dir[MAXPDSTRING], name[MAXPDSTRING];
+    t_class* c;
+    if(libpd_patch_cache_find(canvas_getcurrent(), s->s_name, dir, name))
+    {
+        class_set_extern_dir(gensym(dir));
+        c = class_new(s, (t_newmethod)libpd_patch_cache_create_abstraction, 0, 0, 0, A_GIMME, 0);
+        class_set_extern_dir(&s_);
+        if(c)
+        {
+            typedmess(x, s, argc, argv);
+            return;
+        }
+    }
+    libpd_patch_cache_new_anything(x, s, argc, argv);
+}
+
+void libpd_patch_cache_setup(void)
+{
+    t_class* c = pd_objectmaker;
+    pd_globallock();
+    libpd_patch_cache_new_anything = c->c_anymethod;
+    class_addanything(c, (t_method)libpd_patch_cache_anything);
+    pd_globalunlock();
+}
+
+// Same as glob_evalfile() but the binbuf comes from the cache instead of the disk
+int libpd_patch_cache_openfile(const char* name, const char* path, void** patch)
+{
+    t_pd *x = 0, *boundx, *boundn;
+    t_binbuf* b;
+    int dspstate;
+    sys_lock();
+    b = libpd_patch_cache_get(name, path);
+    if(!b)
+    {
+        sys_unlock();
+        *patch = NULL;
+        return 0;
+    }
+    dspstate = canvas_suspend_dsp();
+    boundx = s__X.s_thing;
+    boundn = s__N.s_thing;
+    s__X.s_thing = 0;
+    s__N.s_thing = &pd_canvasmaker;
+    glob_setfilename(0, gensym(name), gensym(path));
+    binbuf_eval(b, 0, 0, 0);
+    glob_setfilename(0, &s_, &s_);
+    while((x != s__X.s_thing) && s__X.s_thing)
+    {
+        x = s__X.s_thing;
+        vmess(x, gensym("pop"), "i", 1);
+    }
+    pd_doloadbang();
+    canvas_resume_dsp(dspstate);
+    s__X.s_thing = boundx;
+    s__N.s_thing = boundn;
+    binbuf_free(b);
+    sys_unlock();
+    *patch = x;
+    return 1;
+}
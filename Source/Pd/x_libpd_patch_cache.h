@@ -0,0 +1,33 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#ifndef __X_LIBPD_PATCH_CACHE_H__
+#define __X_LIBPD_PATCH_CACHE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <z_libpd.h>
+
+//! @brief Hooks the object maker to instantiate the abstractions from the cache.
+//! @details The abstractions of the directory of the canvases are resolved ahead of\n
+//! vanilla, the others are still resolved and read from the disk by vanilla.
+void libpd_patch_cache_setup(void);
+
+//! @brief Opens a patch from the cache, returns 0 if the file can't be read.
+//! @details The parsed content of the patches and abstractions is shared by all the\n
+//! instances of the process and it is parsed again only if the file has been modified.\n
+//! Returns 1 once the content has been evaluated, the patch is NULL if the content\n
+//! didn't create a canvas and the file must not be opened again.
+int libpd_patch_cache_openfile(const char* name, const char* path, void** patch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
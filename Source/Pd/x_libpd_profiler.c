@@ -0,0 +1,463 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "x_libpd_profiler.h"
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+// False UGEN INSTANCE (only the beginning of the structure defined in d_ugen.c)
+typedef struct _fake_instanceugen
+{
+    t_int *u_dspchain;
+    int u_dspchainsize;
+} t_fake_instanceugen;
+
+typedef struct _profiler_object
+{
+    t_object* object;
+    t_canvas* canvas;
+    double    time;
+} t_profiler_object;
+
+typedef struct _profiler_entry
+{
+    int    object;      // the index of the object or -1 if the routine can't be mapped
+    double time;
+} t_profiler_entry;
+
+typedef struct _libpd_profiler
+{
+    t_pdinstance*       instance;
+    t_int*              chain;      // the original DSP chain
+    int                 chainsize;
+    t_int*              stub;       // the DSP chain installed during the profiling
+    int*                slots;      // the entry of each position of the original chain
+    int                 nslots;
+    t_profiler_entry*   entries;
+    int                 nentries;
+    t_profiler_object*  objects;
+    int                 nobjects;
+    int                 maxobjects;
+    int                 ticks;
+    int                 nticks;
+    int                 state;      // 0 idle, 1 running, 2 done, -1 stopped
+} t_libpd_profiler;
+
+// Returns the time in microseconds
+static double profiler_now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart * 1000000.0 / (double)frequency.QuadPart;
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if(!timebase.denom)
+    {
+        mach_timebase_info(&timebase);
+    }
+    return (double)mach_absolute_time() * (double)timebase.numer / (double)timebase.denom / 1000.0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          OBJECTS                                         //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+static void profiler_add_object(t_libpd_profiler* x, t_object* object, t_canvas* canvas)
+{
+    if(x->nobjects == x->maxobjects)
+    {
+        int const size = x->maxobjects ? x->maxobjects * 2 : 256;
+        x->objects = (t_profiler_object *)resizebytes(x->objects,
+                                                      (size_t)x->maxobjects * sizeof(t_profiler_object),
+                                                      (size_t)size * sizeof(t_profiler_object));
+        x->maxobjects = size;
+    }
+    x->objects[x->nobjects].object = object;
+    x->objects[x->nobjects].canvas = canvas;
+    x->objects[x->nobjects].time   = 0.0;
+    x->nobjects++;
+}
+
+static void profiler_collect_objects(t_libpd_profiler* x, t_canvas* canvas)
+{
+    t_gobj* y;
+    for(y = canvas->gl_list; y; y = y->g_next)
+    {
+        t_object* object = pd_checkobject(&y->g_pd);
+        if(object)
+        {
+            profiler_add_object(x, object, canvas);
+        }
+        if(pd_class(&y->g_pd) == canvas_class)
+        {
+            profiler_collect_objects(x, (t_canvas *)y);
+        }
+    }
+}
+
+static int profiler_compare_objects(const void* a, const void* b)
+{
+    t_object const* oa = ((t_profiler_object const*)a)->object;
+    t_object const* ob = ((t_profiler_object const*)b)->object;
+    return oa < ob ? -1 : (oa > ob ? 1 : 0);
+}
+
+static int profiler_find_object(t_libpd_profiler const* x, t_int value)
+{
+    int low = 0, high = x->nobjects - 1;
+    while(low <= high)
+    {
+        int const mid = (low + high) / 2;
+        t_int const object = (t_int)x->objects[mid].object;
+        if(object == value)
+        {
+            return mid;
+        }
+        else if(object < value)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          PERFORM                                         //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+static void profiler_restore(t_libpd_profiler* x)
+{
+    t_fake_instanceugen* ugen = (t_fake_instanceugen *)x->instance->pd_ugen;
+    ugen->u_dspchain = x->chain;
+    ugen->u_dspchainsize = x->chainsize;
+    x->chain = NULL;
+    x->chainsize = 0;
+}
+
+// Runs the original DSP chain and times each perform routine. The routines are identified
+// by their position in the chain because some routines (block~) jump in the chain. A
+// routine is mapped to the first of its arguments that is an object of the patches.
+static t_int* profiler_perform(t_int* w)
+{
+    t_libpd_profiler* x = (t_libpd_profiler *)(w[1]);
+    t_int* ip = x->chain;
+    while(ip)
+    {
+        int const position = (int)(ip - x->chain);
+        double const start = profiler_now();
+        t_int* next = (*(t_perfroutine)(*ip))(ip);
+        double const elapsed = profiler_now() - start;
+        if(position >= 0 && position < x->chainsize)
+        {
+            int index = x->slots[position];
+            if(index < 0)
+            {
+                t_int* arg;
+                index = x->nentries++;
+                x->slots[position] = index;
+                x->entries[index].object = -1;
+                x->entries[index].time = 0.0;
+                for(arg = ip + 1; next && arg < next && arg < x->chain + x->chainsize; ++arg)
+                {
+                    int const object = profiler_find_object(x, *arg);
+                    if(object >= 0)
+                    {
+                        x->entries[index].object = object;
+                        break;
+                    }
+                }
+            }
+            x->entries[index].time += elapsed;
+        }
+        ip = next;
+    }
+    if(++x->ticks >= x->nticks)
+    {
+        profiler_restore(x);
+        x->state = 2;
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          INTERFACE                                       //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+void* libpd_profiler_new(void)
+{
+    t_libpd_profiler* x = (t_libpd_profiler *)getbytes(sizeof(t_libpd_profiler));
+    if(x)
+    {
+        x->instance = pd_this;
+    }
+    return x;
+}
+
+static void profiler_clear(t_libpd_profiler* x)
+{
+    if(x->slots)
+    {
+        freebytes(x->slots, (size_t)x->nslots * sizeof(int));
+        x->slots = NULL;
+    }
+    if(x->entries)
+    {
+        freebytes(x->entries, (size_t)x->nslots * sizeof(t_profiler_entry));
+        x->entries = NULL;
+    }
+    x->nslots = 0;
+    x->nentries = 0;
+}
+
+// Must be called with the lock
+static void profiler_check(t_libpd_profiler* x)
+{
+    t_fake_instanceugen* ugen = (t_fake_instanceugen *)x->instance->pd_ugen;
+    if(x->state == 1 && ugen->u_dspchain != x->stub)
+    {
+        // the stub has been freed by Pd when the chain has been rebuilt
+        profiler_clear(x);
+        freebytes(x->chain, (size_t)x->chainsize * sizeof(t_int));
+        x->chain = NULL;
+        x->chainsize = 0;
+        x->stub = NULL;
+        x->state = -1;
+    }
+    if(x->state != 1 && x->stub)
+    {
+        freebytes(x->stub, 2 * sizeof(t_int));
+        x->stub = NULL;
+    }
+}
+
+void libpd_profiler_stop(void* profiler)
+{
+    t_libpd_profiler* x = (t_libpd_profiler *)profiler;
+    sys_lock();
+    profiler_check(x);
+    if(x->state == 1)
+    {
+        profiler_restore(x);
+        profiler_clear(x);
+        x->state = -1;
+        profiler_check(x);
+    }
+    sys_unlock();
+}
+
+void libpd_profiler_free(void* profiler)
+{
+    t_libpd_profiler* x = (t_libpd_profiler *)profiler;
+    libpd_profiler_stop(x);
+    sys_lock();
+    profiler_clear(x);
+    if(x->objects)
+    {
+        freebytes(x->objects, (size_t)x->maxobjects * sizeof(t_profiler_object));
+    }
+    sys_unlock();
+    freebytes(x, sizeof(t_libpd_profiler));
+}
+
+int libpd_profiler_start(void* profiler, int nticks)
+{
+    t_canvas* canvas;
+    t_libpd_profiler* x = (t_libpd_profiler *)profiler;
+    t_fake_instanceugen* ugen;
+    libpd_profiler_stop(x);
+    sys_lock();
+    ugen = (t_fake_instanceugen *)x->instance->pd_ugen;
+    if(!ugen->u_dspchain || nticks <= 0)
+    {
+        sys_unlock();
+        return 0;
+    }
+    profiler_clear(x);
+    x->nobjects = 0;
+    for(canvas = pd_getcanvaslist(); canvas; canvas = canvas->gl_next)
+    {
+        profiler_collect_objects(x, canvas);
+    }
+    if(x->nobjects)
+    {
+        qsort(x->objects, (size_t)x->nobjects, sizeof(t_profiler_object), profiler_compare_objects);
+    }
+
+    x->chain     = ugen->u_dspchain;
+    x->chainsize = ugen->u_dspchainsize;
+    x->nslots    = x->chainsize;
+    x->slots     = (int *)getbytes((size_t)x->nslots * sizeof(int));
+    x->entries   = (t_profiler_entry *)getbytes((size_t)x->nslots * sizeof(t_profiler_entry));
+    memset(x->slots, 0xff, (size_t)x->nslots * sizeof(int));
+    x->nentries  = 0;
+    x->ticks     = 0;
+    x->nticks    = nticks;
+
+    // the stub is allocated like a chain of Pd so Pd can free it if it rebuilds the chain
+    x->stub      = (t_int *)getbytes(2 * sizeof(t_int));
+    x->stub[0]   = (t_int)profiler_perform;
+    x->stub[1]   = (t_int)x;
+    ugen->u_dspchain = x->stub;
+    ugen->u_dspchainsize = 2;
+    x->state = 1;
+    sys_unlock();
+    return 1;
+}
+
+int libpd_profiler_poll(void* profiler)
+{
+    int state;
+    t_libpd_profiler* x = (t_libpd_profiler *)profiler;
+    sys_lock();
+    profiler_check(x);
+    state = x->state;
+    sys_unlock();
+    return state == 2 ? 1 : (state == 1 ? 0 : -1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          REPORT                                          //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+static void profiler_canvas_path(t_canvas const* canvas, char* buffer, size_t size)
+{
+    if(canvas->gl_owner)
+    {
+        size_t length;
+        profiler_canvas_path(canvas->gl_owner, buffer, size);
+        length = strlen(buffer);
+        snprintf(buffer + length, size > length ? size - length : 0, "/%s", canvas->gl_name->s_name);
+    }
+    else
+    {
+        snprintf(buffer, size, "%s", canvas->gl_name->s_name);
+    }
+}
+
+static int profiler_compare_times(const void* a, const void* b)
+{
+    double const ta = ((t_profiler_object const*)a)->time;
+    double const tb = ((t_profiler_object const*)b)->time;
+    return ta > tb ? -1 : (ta < tb ? 1 : 0);
+}
+
+void libpd_profiler_report(void* profiler, t_libpd_profiler_hook hook, void* user)
+{
+    int i;
+    char line[MAXPDSTRING], path[MAXPDSTRING];
+    double total = 0.0, unmapped = 0.0, ticks;
+    t_profiler_object* canvases;
+    int ncanvases = 0;
+    t_libpd_profiler* x = (t_libpd_profiler *)profiler;
+    sys_lock();
+    if(x->state != 2 || !x->entries)
+    {
+        sys_unlock();
+        return;
+    }
+    ticks = (double)(x->ticks > 0 ? x->ticks : 1);
+    for(i = 0; i < x->nobjects; ++i)
+    {
+        x->objects[i].time = 0.0;
+    }
+    for(i = 0; i < x->nentries; ++i)
+    {
+        total += x->entries[i].time;
+        if(x->entries[i].object >= 0)
+        {
+            x->objects[x->entries[i].object].time += x->entries[i].time;
+        }
+        else
+        {
+            unmapped += x->entries[i].time;
+        }
+    }
+    if(total <= 0.0)
+    {
+        total = 1.0;
+    }
+
+    // The time of an object is added to its canvas and to the owners of its canvas
+    canvases = (t_profiler_object *)getbytes((size_t)(x->nobjects + 1) * sizeof(t_profiler_object));
+    for(i = 0; i < x->nobjects; ++i)
+    {
+        t_canvas* canvas;
+        if(x->objects[i].time <= 0.0)
+        {
+            continue;
+        }
+        for(canvas = x->objects[i].canvas; canvas; canvas = canvas->gl_owner)
+        {
+            int j;
+            for(j = 0; j < ncanvases && canvases[j].canvas != canvas; ++j) {}
+            if(j == ncanvases)
+            {
+                canvases[j].canvas = canvas;
+                canvases[j].object = NULL;
+                canvases[j].time = 0.0;
+                ++ncanvases;
+            }
+            canvases[j].time += x->objects[i].time;
+        }
+    }
+
+    snprintf(line, MAXPDSTRING, "profile: %d ticks, %.2f us per tick", x->ticks, total / ticks);
+    hook(user, line);
+    hook(user, "canvases:");
+    qsort(canvases, (size_t)ncanvases, sizeof(t_profiler_object), profiler_compare_times);
+    for(i = 0; i < ncanvases; ++i)
+    {
+        profiler_canvas_path(canvases[i].canvas, path, MAXPDSTRING);
+        snprintf(line, MAXPDSTRING, "  %10.2f us %6.2f%%  %s", canvases[i].time / ticks,
+                 canvases[i].time / total * 100.0, path);
+        hook(user, line);
+    }
+    hook(user, "objects:");
+    qsort(x->objects, (size_t)x->nobjects, sizeof(t_profiler_object), profiler_compare_times);
+    for(i = 0; i < x->nobjects && x->objects[i].time > 0.0; ++i)
+    {
+        char* text = NULL;
+        int length = 0;
+        binbuf_gettext(x->objects[i].object->te_binbuf, &text, &length);
+        profiler_canvas_path(x->objects[i].canvas, path, MAXPDSTRING);
+        snprintf(line, MAXPDSTRING, "  %10.2f us %6.2f%%  [%.*s] in %s", x->objects[i].time / ticks,
+                 x->objects[i].time / total * 100.0, length > 64 ? 64 : length, text ? text : "", path);
+        if(text)
+        {
+            freebytes(text, (size_t)length);
+        }
+        hook(user, line);
+    }
+    // the objects aren't sorted by address anymore
+    qsort(x->objects, (size_t)x->nobjects, sizeof(t_profiler_object), profiler_compare_objects);
+    snprintf(line, MAXPDSTRING, "unmapped routines: %.2f us %.2f%%", unmapped / ticks, unmapped / total * 100.0);
+    hook(user, line);
+    freebytes(canvases, (size_t)(x->nobjects + 1) * sizeof(t_profiler_object));
+    sys_unlock();
+}
@@ -0,0 +1,44 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#ifndef __X_LIBPD_PROFILER_H__
+#define __X_LIBPD_PROFILER_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <z_libpd.h>
+
+typedef void (*t_libpd_profiler_hook)(void* user, const char* line);
+
+//! @brief Creates a profiler for the current instance.
+void* libpd_profiler_new(void);
+
+//! @brief Stops and frees a profiler.
+void libpd_profiler_free(void* profiler);
+
+//! @brief Starts to time each perform routine of the DSP chain during a number of ticks.
+//! @details The routines are mapped to the objects of the patches using their arguments.\n
+//! Returns 0 if the DSP is off.
+int libpd_profiler_start(void* profiler, int nticks);
+
+//! @brief Stops the profiler and restores the DSP chain.
+void libpd_profiler_stop(void* profiler);
+
+//! @brief Gets if the profiler is done (1), running (0) or stopped (-1).
+//! @details A profiler is stopped when the DSP chain has been rebuilt during the profiling.
+int libpd_profiler_poll(void* profiler);
+
+//! @brief Calls the hook for each line of the report of the profiler.
+void libpd_profiler_report(void* profiler, t_libpd_profiler_hook hook, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
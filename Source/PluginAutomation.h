@@ -0,0 +1,28 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+// ======================================================================================== //
+//                                      AUTOMATION                                          //
+// ======================================================================================== //
+
+//! @brief The interface of a processor that can apply the changes of the parameters at a\n
+//! sample of the block.
+//! @details The wrapper of the plugin format (LV2 patch:Set) adds the changes of the block\n
+//! in the order of the samples before calling processBlock(), the changes of the control\n
+//! ports are added first at the sample 0. The processor applies each change before the Pd\n
+//! tick that contains its sample.
+class CamomileAutomation
+{
+public:
+    virtual ~CamomileAutomation() = default;
+
+    //! @brief Adds a change of a parameter at a sample of the next block.
+    //! @details The value is not normalized. The method is called by the audio thread and\n
+    //! returns false if the change can't be queued, the wrapper must apply it directly.
+    virtual bool addParameterChange(int index, float value, int sample) = 0;
+};
@@ -22,6 +22,17 @@
 #define JucePlugin_Manufacturer CamomileEnvironment::getPluginManufacturerUTF8()
 #define JucePlugin_LV2URI (juce::String("urn:Camomile:") + juce::String(JucePlugin_Name)).toUTF8()
 
+// The command line tools (renderer, benchmark) initialize the environment from their
+// arguments so the project information can't use it during the static initialization.
+#if CAMOMILE_TOOL
+namespace ProjectInfo
+{
+    const char* const  projectName    = "Camomile";
+    const char* const  companyName    = "Camomile";
+    const char* const  versionString  = JucePlugin_VersionString;
+    const int          versionNumber  = 0x1008;
+}
+#else
 namespace ProjectInfo
 {
     const char* const  projectName    = JucePlugin_Name;
@@ -29,3 +40,4 @@ namespace ProjectInfo
     const char* const  versionString  = JucePlugin_VersionString;
     const int          versionNumber  = 0x1008;
 }
+#endif
@@ -0,0 +1,80 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginDescriptor.h"
+#include "PluginProcessor.h"
+#include "PluginParameter.h"
+#include "PluginState.h"
+#include <iostream>
+
+// ======================================================================================== //
+//                                      DESCRIPTOR                                          //
+// ======================================================================================== //
+
+CamomileAudioDescriptor::CamomileAudioDescriptor() :
+AudioProcessor(CamomileAudioProcessor::getDefaultBusesProperties(false)),
+m_name(CamomileEnvironment::getPluginName()),
+m_accepts_midi(CamomileEnvironment::wantsMidi()),
+m_produces_midi(CamomileEnvironment::producesMidi()),
+m_is_midi_effect(CamomileEnvironment::isMidiOnly()),
+m_tail_length(static_cast<double>(CamomileEnvironment::getTailLengthSeconds())),
+m_programs(CamomileEnvironment::getPrograms())
+{
+    for(auto const& error : CamomileEnvironment::getErrors())
+    {
+        std::cerr << "error : " << error << "\n";
+    }
+    if(CamomileEnvironment::isValid())
+    {
+        // the parameters are created like the processor does so the ports are the same
+        auto const& params = CamomileEnvironment::getParams();
+        for(size_t i = 0; i < params.size(); ++i)
+        {
+            try
+            {
+                addParameter(CamomileAudioParameter::parse(params[i]));
+            }
+            catch(std::string const& message)
+            {
+                std::cerr << "error : parameter " << i+1 << ": " << message << "\n";
+            }
+        }
+    }
+}
+
+bool CamomileAudioDescriptor::isBusesLayoutSupported(const BusesLayout& layouts) const
+{
+    return CamomileAudioProcessor::isBusesLayoutSupportedByEnvironment(layouts);
+}
+
+void CamomileAudioDescriptor::setCurrentProgram(int index)
+{
+    if(static_cast<size_t>(index) < m_programs.size())
+    {
+        m_program_current = index;
+    }
+}
+
+const String CamomileAudioDescriptor::getProgramName(int index)
+{
+    if(static_cast<size_t>(index) < m_programs.size())
+    {
+        return String(m_programs[static_cast<size_t>(index)]);
+    }
+    return String();
+}
+
+void CamomileAudioDescriptor::getStateInformation(MemoryBlock& destData)
+{
+    CamomileState state;
+    state.program = m_program_current;
+    state.write(destData);
+}
+
+AudioProcessor* JUCE_CALLTYPE createPluginDescriptor()
+{
+    return new CamomileAudioDescriptor();
+}
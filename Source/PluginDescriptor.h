@@ -0,0 +1,64 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <string>
+#include <vector>
+
+// ======================================================================================== //
+//                                      DESCRIPTOR                                          //
+// ======================================================================================== //
+
+//! @brief A processor that describes the plugin from its environment only.
+//! @details The descriptor has the buses, the parameters and the programs defined in the\n
+//! text file of the plugin but it doesn't create an instance of Pd nor open the patch, so\n
+//! it's fast to create and it can't process. It's used to generate the LV2 files. Its\n
+//! state only selects the current program.
+class CamomileAudioDescriptor : public AudioProcessor
+{
+public:
+    CamomileAudioDescriptor();
+    ~CamomileAudioDescriptor() = default;
+
+    void prepareToPlay (double, int) override {}
+    void releaseResources() override {}
+    void processBlock (AudioSampleBuffer& buffer, MidiBuffer&) override { buffer.clear(); }
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+
+    AudioProcessorEditor* createEditor() override { return nullptr; }
+    bool hasEditor() const override { return true; }
+
+    const String getName() const override { return m_name; }
+    bool acceptsMidi() const override { return m_accepts_midi; }
+    bool producesMidi() const override { return m_produces_midi; }
+    bool isMidiEffect () const override { return m_is_midi_effect; }
+    double getTailLengthSeconds() const override { return m_tail_length; }
+
+    int getNumPrograms() override { return static_cast<int>(m_programs.size()); };
+    int getCurrentProgram() override { return m_program_current; }
+    void setCurrentProgram (int index) override;
+    const String getProgramName (int index) override;
+    void changeProgramName (int, const String&) override {}
+
+    void getStateInformation (MemoryBlock& destData) override;
+    void setStateInformation (const void*, int) override {}
+
+private:
+    String const                    m_name;
+    bool const                      m_accepts_midi;
+    bool const                      m_produces_midi;
+    bool const                      m_is_midi_effect;
+    double const                    m_tail_length;
+    std::vector<std::string> const  m_programs;
+    int                             m_program_current = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CamomileAudioDescriptor)
+};
+
+//! @brief Creates the descriptor of the plugin.
+AudioProcessor* JUCE_CALLTYPE createPluginDescriptor();
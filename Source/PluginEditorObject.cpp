@@ -7,6 +7,7 @@
 #include "PluginEditorObject.hpp"
 #include "PluginLookAndFeel.hpp"
 #include <algorithm>
+#include <unordered_set>
 
 //////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////     PATCH              ////////////////////////////
@@ -22,18 +23,20 @@ GuiPatch::GuiPatch(CamomileEditorMouseManager& processor, pd::Patch patch) : m_p
 void GuiPatch::updateObjects()
 {
     auto guis = m_patch.getGuis();
-    auto isObjectDeprecated = [&](object_pair const& pair)
+    std::unordered_set<void const*> ids;
+    ids.reserve(guis.size());
+    for(auto const& gui : guis)
     {
-        return pair.first != nullptr && std::find(guis.begin(), guis.end(), pair.first->getGUI()) == guis.end();
-    };
-    m_objects.erase(std::remove_if(m_objects.begin(), m_objects.end(), isObjectDeprecated), m_objects.end());
+        ids.insert(gui.getId());
+    }
+    for(auto it = m_objects.begin(); it != m_objects.end();)
+    {
+        it = ids.count(it->first) ? std::next(it) : m_objects.erase(it);
+    }
     
     for(auto& gui : guis)
     {
-        auto it = std::find_if(m_objects.begin(), m_objects.end(), [&gui](object_pair const& pair)
-                               {
-            return pair.first != nullptr && pair.first->getGUI() == gui;
-        });
+        auto it = m_objects.find(gui.getId());
         if(it == m_objects.end())
         {
             object_uptr object(PluginEditorObject::createTyped(m_processor, gui));
@@ -45,18 +48,19 @@ void GuiPatch::updateObjects()
                 {
                     addAndMakeVisible(label.get());
                 }
-                m_objects.push_back({std::move(object), std::move(label)});
+                m_objects.emplace(gui.getId(), object_pair{std::move(object), std::move(label)});
             }
         }
         else
         {
-            it->first->updateInterface();
-            auto label = it->first->getLabel();
+            auto& pair = it->second;
+            pair.first->updateInterface();
+            auto label = pair.first->getLabel();
             if(label != nullptr)
             {
                 addAndMakeVisible(label.get());
             }
-            it->second = std::move(label);
+            pair.second = std::move(label);
         }
     }
 }
@@ -73,9 +77,9 @@ void GuiPatch::updateObjectsValues()
 {
     for(auto const& object : m_objects)
     {
-        if(object.first != nullptr)
+        if(object.second.first != nullptr)
         {
-            object.first->updateValue();
+            object.second.first->updateValue();
         }
     }
 }
@@ -150,9 +154,66 @@ value(g.getValue()), min(g.getMinimum()), max(g.getMaximum())
 {
     setOpaque(false);
     updateInterface();
+    m_slot = gui.watch();
+    if(m_slot >= 0)
+    {
+        // the first update always reads the value
+        m_version = gui.getPublishedVersion(m_slot) - 1;
+    }
 }
 
-PluginEditorObject::~PluginEditorObject() {}
+PluginEditorObject::~PluginEditorObject()
+{
+    gui.unwatch(m_slot);
+}
+
+bool PluginEditorObject::hasChanged() noexcept
+{
+    if(m_slot >= 0)
+    {
+        uint32_t const version = gui.getPublishedVersion(m_slot);
+        if(version == m_version)
+        {
+            return false;
+        }
+        m_version = version;
+    }
+    return true;
+}
+
+float PluginEditorObject::getPublishedValue() const noexcept
+{
+    return m_slot >= 0 ? gui.getPublishedValue(m_slot) : gui.getValue();
+}
+
+juce::String PluginEditorObject::getPublishedText() const
+{
+    if(m_slot >= 0)
+    {
+        return juce::String(gui.getPublishedText(m_slot));
+    }
+    if(gui.getType() == pd::Gui::Type::AtomSymbol)
+    {
+        return juce::String(gui.getSymbol());
+    }
+    juce::String message;
+    for(auto const& atom : gui.getList())
+    {
+        if(message.isNotEmpty())
+        {
+            message += " ";
+        }
+        if(atom.isFloat())
+        {
+            message += juce::String(atom.getFloat());
+        }
+        else if(atom.isSymbol())
+        {
+            message += juce::String(atom.getSymbol());
+        }
+    }
+    return message;
+}
 
 float PluginEditorObject::getValueOriginal() const noexcept
 {
@@ -192,9 +253,9 @@ void PluginEditorObject::stopEdition() noexcept
 
 void PluginEditorObject::updateValue()
 {
-    if(edited == false)
+    if(edited == false && hasChanged())
     {
-        float const v = gui.getValue();
+        float const v = getPublishedValue();
         if(v != value)
         {
             value = v;
@@ -265,6 +326,20 @@ void GuiBang::paint(Graphics& g)
     g.drawRect(getLocalBounds(), static_cast<int>(border));
 }
 
+void GuiBang::updateValue()
+{
+    // the bang is turned off if there was no new flash since the last update
+    if(edited == false)
+    {
+        float const v = hasChanged() ? getPublishedValue() : 0.f;
+        if(v != value)
+        {
+            value = v;
+            repaint();
+        }
+    }
+}
+
 void GuiBang::mouseDown(const MouseEvent& e)
 {
     startEdition();
@@ -626,9 +701,9 @@ void GuiTextEditor::mouseDoubleClick(const juce::MouseEvent&)
 
 void GuiTextEditor::updateValue()
 {
-    if(edited == false && !label.isBeingEdited())
+    if(edited == false && !label.isBeingEdited() && hasChanged())
     {
-        value = gui.getValue();
+        value = getPublishedValue();
         label.setText(juce::String(value), juce::NotificationType::dontSendNotification);
     }
 }
@@ -843,9 +918,9 @@ void GuiAtomSymbol::paint(juce::Graphics& g)
 
 void GuiAtomSymbol::updateValue()
 {
-    if(edited == false && !label.isBeingEdited())
+    if(edited == false && !label.isBeingEdited() && hasChanged())
     {
-        label.setText(juce::String(gui.getSymbol()), juce::NotificationType::dontSendNotification);
+        label.setText(getPublishedText(), juce::NotificationType::dontSendNotification);
     }
 }
 
@@ -912,26 +987,9 @@ void GuiAtomList::paint(juce::Graphics& g)
 
 void GuiAtomList::updateValue()
 {
-    if(edited == false && !label.isBeingEdited())
+    if(edited == false && !label.isBeingEdited() && hasChanged())
     {
-        auto const array = gui.getList();
-        juce::String message;
-        for(auto const& atom : array)
-        {
-            if(message.isNotEmpty())
-            {
-                message += " ";
-            }
-            if(atom.isFloat())
-            {
-                message += juce::String(atom.getFloat());
-            }
-            else if(atom.isSymbol())
-            {
-                message += juce::String(atom.getSymbol());
-            }
-        }
-        label.setText(message, juce::NotificationType::dontSendNotification);
+        label.setText(getPublishedText(), juce::NotificationType::dontSendNotification);
     }
 }
 
@@ -983,9 +1041,7 @@ void GuiGraphOnParent::updateInterface()
 GraphicalArray::GraphicalArray(CamomileAudioProcessor& processor, pd::Array& graph) :
 m_processor(processor), m_array(graph), m_edited(false)
 {
-    m_vector.reserve(8192);
-    m_temp.reserve(8192);
-    try { m_array.read(m_vector); }
+    try { update(); }
     catch(...) { m_error = true; }
     startTimer(100);
     setInterceptsMouseClicks(true, false);
@@ -1037,10 +1093,11 @@ void GraphicalArray::paint(Graphics& g)
             auto const x1 = static_cast<float>(i);
             auto const currentIndex = static_cast<size_t>(x1 * wRadio);
             auto const nextIndex = static_cast<size_t>((x1 + 1.0f) * wRadio);
-            auto const max = std::max_element(m_vector.cbegin()+currentIndex, m_vector.cbegin()+nextIndex, [](float const lhs, float const rhs) { return std::abs(lhs) < std::abs(rhs); });
-            if(max != m_vector.cend())
+            if(currentIndex < m_vector.size())
             {
-                auto const y = std::floor(height - (*max - scale[0]) * dh);
+                auto const minmax = getRange(currentIndex, nextIndex);
+                auto const max = std::abs(minmax.first) > std::abs(minmax.second) ? minmax.first : minmax.second;
+                auto const y = std::floor(height - (max - scale[0]) * dh);
                 p.lineTo(x1, y);
             }
         }
@@ -1054,11 +1111,11 @@ void GraphicalArray::paint(Graphics& g)
             auto const x1 = static_cast<float>(i);
             auto const currentIndex = static_cast<size_t>(x1 * wRadio);
             auto const nextIndex = static_cast<size_t>((x1 + 1.0f) * wRadio);
-            auto const minmax = std::minmax_element(m_vector.cbegin()+currentIndex, m_vector.cbegin()+nextIndex);
-            if(minmax.first != m_vector.cend() && minmax.first != m_vector.cend())
+            if(currentIndex < m_vector.size())
             {
-                auto const y1 = std::floor(height - (*minmax.second - scale[0]) * dh);
-                auto const y2 = std::floor(height - (*minmax.first - scale[0]) * dh);
+                auto const minmax = getRange(currentIndex, nextIndex);
+                auto const y1 = std::floor(height - (minmax.second - scale[0]) * dh);
+                auto const y2 = std::floor(height - (minmax.first - scale[0]) * dh);
                 rectangles.add(x1, y1, 1.0f , std::max(y2 - y1, 1.0f));
             }
         }
@@ -1089,6 +1146,7 @@ void GraphicalArray::mouseDrag(const MouseEvent& event)
     const std::array<float, 2> scale = m_array.getScale();
     const size_t index = static_cast<size_t>(std::round(clip(x / w, 0.f, 1.f) * s));
     m_vector[index] = (1.f - clip(y / h, 0.f, 1.f)) * (scale[1] - scale[0]) + scale[0];
+    decimate(index, index + 1);
     const CriticalSection& cs = m_processor.getCallbackLock();
     if(cs.tryEnter())
     {
@@ -1112,14 +1170,120 @@ void GraphicalArray::timerCallback()
     if(!m_edited)
     {
         m_error = false;
-        try { m_array.read(m_temp); }
+        try
+        {
+            if(update())
+            {
+                repaint();
+            }
+        }
         catch(...) { m_error = true; }
-        if(m_temp != m_vector)
+    }
+}
+
+bool GraphicalArray::update()
+{
+    // the array is skipped if its version and its size didn't change, the checksums are still
+    // computed once per second for the objects of Pd that write the array directly
+    uint32_t version = 0;
+    size_t const current = m_array.getVersion(version);
+    if(!m_checksums.empty() && version == m_version && current == m_vector.size() && ++m_nskipped < 10)
+    {
+        return false;
+    }
+    m_version  = version;
+    m_nskipped = 0;
+    size_t const size = m_array.getChecksums(m_temp);
+    if(size != m_vector.size())
+    {
+        m_array.read(m_vector);
+        m_checksums.swap(m_temp);
+        m_pyramid.clear();
+        for(size_t length = (m_vector.size() + 1) / 2; length > 0; length = length > 1 ? (length + 1) / 2 : 0)
         {
-            m_vector.swap(m_temp);
-            repaint();
+            m_pyramid.push_back(std::vector<range>(length));
+        }
+        decimate(0, m_vector.size());
+        return true;
+    }
+    
+    // the contiguous chunks that changed are read at once
+    bool changed = false;
+    size_t const nchunks = std::min(m_temp.size(), m_checksums.size());
+    for(size_t i = 0; i < nchunks;)
+    {
+        if(m_temp[i] == m_checksums[i])
+        {
+            ++i;
+            continue;
+        }
+        size_t j = i + 1;
+        while(j < nchunks && m_temp[j] != m_checksums[j])
+        {
+            ++j;
         }
+        size_t const start = i * pd::Array::chunk_size;
+        size_t const end   = std::min(j * pd::Array::chunk_size, size);
+        m_array.read(m_vector, start, end - start);
+        decimate(start, end);
+        changed = true;
+        i = j;
+    }
+    m_checksums.swap(m_temp);
+    return changed;
+}
+
+void GraphicalArray::decimate(size_t start, size_t end)
+{
+    if(m_pyramid.empty() || start >= end)
+    {
+        return;
+    }
+    size_t first = start / 2, last = (end - 1) / 2;
+    auto& base = m_pyramid[0];
+    for(size_t i = first; i <= last; ++i)
+    {
+        float const v1 = m_vector[i * 2];
+        float const v2 = m_vector[std::min(i * 2 + 1, m_vector.size() - 1)];
+        base[i] = std::minmax(v1, v2);
+    }
+    for(size_t level = 1; level < m_pyramid.size(); ++level)
+    {
+        auto const& lower = m_pyramid[level-1];
+        auto& upper = m_pyramid[level];
+        first /= 2; last /= 2;
+        for(size_t i = first; i <= last; ++i)
+        {
+            auto const& r1 = lower[i * 2];
+            auto const& r2 = lower[std::min(i * 2 + 1, lower.size() - 1)];
+            upper[i] = {std::min(r1.first, r2.first), std::max(r1.second, r2.second)};
+        }
+    }
+}
+
+std::pair<float, float> GraphicalArray::getRange(size_t start, size_t end) const noexcept
+{
+    // an empty range returns the value at the start like the drawing of a single value
+    end = std::min(std::max(end, start + 1), m_vector.size());
+    range result = {m_vector[start], m_vector[start]};
+    auto add = [&result](range const& r)
+    {
+        result.first  = std::min(result.first, r.first);
+        result.second = std::max(result.second, r.second);
+    };
+    
+    // the range is covered by the largest nodes of the pyramid, like a segment tree
+    if(start & 1) { add({m_vector[start], m_vector[start]}); ++start; }
+    if(end & 1)   { --end; add({m_vector[end], m_vector[end]}); }
+    start /= 2; end /= 2;
+    for(size_t level = 0; level < m_pyramid.size() && start < end; ++level)
+    {
+        auto const& values = m_pyramid[level];
+        if(start & 1) { add(values[start]); ++start; }
+        if(end & 1)   { --end; add(values[end]); }
+        start /= 2; end /= 2;
     }
+    return result;
 }
 
 size_t GraphicalArray::getArraySize() const noexcept
@@ -9,6 +9,7 @@
 #include "PluginEditorInteraction.h"
 #include "Pd/PdInstance.hpp"
 #include <atomic>
+#include <unordered_map>
 
 class PluginEditorObject;
 
@@ -31,7 +32,7 @@ private:
     CamomileEditorMouseManager& m_processor;
 protected:
     pd::Patch m_patch;
-    std::vector<object_pair> m_objects;
+    std::unordered_map<void const*, object_pair> m_objects;
 };
 
 // ==================================================================================== //
@@ -53,10 +54,26 @@ private:
         return std::max(std::min(n, upper), lower);
     }
     
+    //! @brief Reads the ranges of the array that changed and returns true if any.
+    bool update();
+    //! @brief Updates the decimation of a range of values.
+    void decimate(size_t start, size_t end);
+    //! @brief Gets the minimum and the maximum values of a range.
+    std::pair<float, float> getRange(size_t start, size_t end) const noexcept;
+    
+    using range = std::pair<float, float>;
+    
     CamomileAudioProcessor& m_processor;
     pd::Array               m_array;
     std::vector<float>      m_vector;
-    std::vector<float>      m_temp;
+    std::vector<uint32_t>   m_checksums;
+    std::vector<uint32_t>   m_temp;
+    //! @brief The version of the array when the checksums were computed.
+    uint32_t                m_version = 0;
+    //! @brief The number of updates since the checksums were computed.
+    int                     m_nskipped = 0;
+    //! @brief The min/max decimation, each level halves the number of values of the previous one.
+    std::vector<std::vector<range>> m_pyramid;
     std::atomic<bool>       m_edited;
     bool                    m_error = false;
     const std::string string_array = std::string("array");
@@ -86,6 +103,14 @@ protected:
     void startEdition() noexcept;
     void stopEdition() noexcept;
     
+    //! @brief Returns true if the value published by the audio thread changed.
+    //! @details If the GUI isn't watched, the method always returns true.
+    bool hasChanged() noexcept;
+    //! @brief Gets the value published by the audio thread.
+    float getPublishedValue() const noexcept;
+    //! @brief Gets the text of a symbol or a list published by the audio thread.
+    juce::String getPublishedText() const;
+    
     pd::Gui     gui;
     CamomileEditorMouseManager&   patch;
     std::atomic<bool> edited;
@@ -94,6 +119,8 @@ protected:
     float       max     = 1;
 
 private:
+    int         m_slot    = -1;
+    uint32_t    m_version = 0;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginEditorObject)
 };
 
@@ -102,6 +129,7 @@ class GuiBang : public PluginEditorObject
 public:
     GuiBang(CamomileEditorMouseManager& p, pd::Gui& g) : PluginEditorObject(p, g) {}
     void paint(Graphics& g) override;
+    void updateValue() override;
     void mouseDown(const MouseEvent& e) override;
     void mouseUp(const MouseEvent& e) override;
 };
@@ -161,6 +189,7 @@ class GuiPanel : public PluginEditorObject
 public:
     GuiPanel(CamomileEditorMouseManager& p, pd::Gui& g);
     void paint(Graphics& g) override;
+    void updateValue() override {}
 };
 
 class GuiComment : public PluginEditorObject
@@ -168,6 +197,7 @@ class GuiComment : public PluginEditorObject
 public:
     GuiComment(CamomileEditorMouseManager& p, pd::Gui& g);
     void paint(Graphics& g) override;
+    void updateValue() override {}
 };
 
 class GuiTextEditor : public PluginEditorObject
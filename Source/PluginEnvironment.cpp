@@ -7,6 +7,7 @@
 #include "PluginConfig.h"
 #include "PluginParser.h"
 #include <JuceHeader.h>
+#include <algorithm>
 #include <cctype>
 #include <string>
 
@@ -31,6 +32,18 @@ CamomileEnvironment& CamomileEnvironment::get()
 
 bool CamomileEnvironment::initialize() { return isValid(); }
 
+static std::string& getFolderLocation()
+{
+    static std::string folder;
+    return folder;
+}
+
+bool CamomileEnvironment::initialize(std::string const& folder)
+{
+    getFolderLocation() = folder;
+    return isValid();
+}
+
 const char* CamomileEnvironment::getPluginNameUTF8() { return get().plugin_name.c_str(); }
 
 std::string CamomileEnvironment::getPluginName() { return get().plugin_name; }
@@ -86,6 +99,12 @@ bool CamomileEnvironment::wantsAutoProgram() { return get().m_auto_program; }
 
 bool CamomileEnvironment::wantsAutoBypass() { return get().m_auto_bypass; }
 
+std::string CamomileEnvironment::getVoicePatchName() { return get().m_voice_patch; }
+
+size_t CamomileEnvironment::getNumVoices() { return get().m_nvoices; }
+
+std::string CamomileEnvironment::getPipelinePatchName() { return get().m_pipeline_patch; }
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 //                                          PROGRAMS                                        //
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -94,6 +113,10 @@ std::vector<std::string> const& CamomileEnvironment::getPrograms() { return get(
 
 std::vector<std::string> const& CamomileEnvironment::getParams() { return get().m_params; }
 
+std::vector<std::string> const& CamomileEnvironment::getSavedArrays() { return get().m_saved_arrays; }
+
+std::vector<std::pair<std::string, std::string>> const& CamomileEnvironment::getSharedArrays() { return get().m_shared_arrays; }
+
 std::vector<CamomileEnvironment::buses_layout> const& CamomileEnvironment::getBusesLayouts() { return get().m_buses_layouts; }
 
 std::vector<std::string> const& CamomileEnvironment::getErrors() { return get().errors; }
@@ -104,6 +127,21 @@ std::vector<std::string> const& CamomileEnvironment::getErrors() { return get().
 
 bool CamomileEnvironment::localize()
 {
+    if(!getFolderLocation().empty())
+    {
+        File folder(getFolderLocation());
+        if(folder.isDirectory())
+        {
+            plugin_name = folder.getFileName().toStdString();
+            plugin_path = folder.getParentDirectory().getFullPathName().toStdString();
+            patch_name = plugin_name + std::string(".pd");
+            patch_path = folder.getFullPathName().toStdString();
+            return true;
+        }
+        errors.push_back("can't localize the plugin folder: ");
+        errors.push_back(folder.getFullPathName().toStdString());
+        return false;
+    }
 #ifdef JUCE_MAC
     File plugin(File::getSpecialLocation(File::currentApplicationFile));
     if(plugin.exists() && plugin.hasFileExtension("dylib"))
@@ -260,6 +298,31 @@ CamomileEnvironment::CamomileEnvironment()
                         {
                             m_programs.push_back(CamomileParser::getString(entry.second));
                         }
+                        else if(entry.first == "savearray")
+                        {
+                            auto const name = CamomileParser::getString(entry.second);
+                            if(std::find(m_saved_arrays.begin(), m_saved_arrays.end(), name) != m_saved_arrays.end())
+                            {
+                                throw std::string("already defined");
+                            }
+                            m_saved_arrays.push_back(name);
+                        }
+                        else if(entry.first == "sharedarray")
+                        {
+                            // the name of the array followed by the path of the file
+                            size_t const pos = entry.second.find_first_of(' ');
+                            if(pos == std::string::npos)
+                                throw std::string("expects an array and a file");
+                            std::string const name = entry.second.substr(0, pos);
+                            for(auto const& shared : m_shared_arrays)
+                            {
+                                if(shared.first == name)
+                                    throw std::string("already defined");
+                            }
+                            std::string const path = CamomileParser::getString(entry.second.substr(entry.second.find_first_not_of(' ', pos)));
+                            File const file = File::isAbsolutePath(path) ? File(path) : File(patch_path).getChildFile(path);
+                            m_shared_arrays.push_back({name, file.getFullPathName().toStdString()});
+                        }
                         else if(entry.first == "bus")
                         {
                             auto const val = CamomileParser::getTwoUnsignedIntegers(entry.second);
@@ -374,6 +437,28 @@ CamomileEnvironment::CamomileEnvironment()
                             m_auto_bypass = CamomileParser::getBool(entry.second);
                             state.set(init_auto_bypass);
                         }
+                        else if(entry.first == "voices")
+                        {
+                            if(state.test(init_voices))
+                                throw std::string("already defined");
+                            // the number of voices followed by the name of the patch
+                            size_t const pos = entry.second.find_first_of(' ');
+                            if(pos == std::string::npos)
+                                throw std::string("expects a number of voices and a patch");
+                            int const nvoices = CamomileParser::getInteger(entry.second.substr(0, pos));
+                            if(nvoices < 1 || nvoices > 128)
+                                throw std::string("number of voices must be between 1 and 128");
+                            m_voice_patch = CamomileParser::getString(entry.second.substr(entry.second.find_first_not_of(' ', pos)));
+                            m_nvoices = static_cast<size_t>(nvoices);
+                            state.set(init_voices);
+                        }
+                        else if(entry.first == "pipeline")
+                        {
+                            if(state.test(init_pipeline))
+                                throw std::string("already defined");
+                            m_pipeline_patch = CamomileParser::getString(entry.second);
+                            state.set(init_pipeline);
+                        }
                         else if(entry.first == "type")
                         {
                             if(state.test(init_type))
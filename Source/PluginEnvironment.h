@@ -35,6 +35,11 @@ public:
     //! @brief Initialize the environment (only if you want to do it in advance).
     static bool initialize();
     
+    //! @brief Initialize the environment from a plugin folder instead of the plugin binary.
+    //! @details The folder must contain the patch and the text file named after the folder.\n
+    //! The method must be called before any other method (used by the offline renderer).
+    static bool initialize(std::string const& folder);
+    
     //! @brief Gets the name used by the plugin.
     static const char* getPluginNameUTF8();
     
@@ -108,6 +113,16 @@ public:
     //! @brief Gets if the plugin wants to auto bypass the process.
     static bool wantsAutoBypass();
     
+    //! @brief Gets the name of the patch of the voices (empty if the plugin has no voices).
+    static std::string getVoicePatchName();
+    
+    //! @brief Gets the number of voices.
+    static size_t getNumVoices();
+    
+    //! @brief Gets the name of the patch of the second stage of the pipeline (empty if the\n
+    //! plugin has no pipeline).
+    static std::string getPipelinePatchName();
+    
     //////////////////////////////////////////////////////////////////////////////////////////
     //                                      PROGRAMS                                        //
     //////////////////////////////////////////////////////////////////////////////////////////
@@ -118,6 +133,13 @@ public:
     //! @brief Gets the parameters.
     static std::vector<std::string> const& getParams();
     
+    //! @brief Gets the names of the arrays saved within the state.
+    static std::vector<std::string> const& getSavedArrays();
+    
+    //! @brief Gets the names of the arrays and the paths of the sample files shared by the\n
+    //! instances of the process.
+    static std::vector<std::pair<std::string, std::string>> const& getSharedArrays();
+    
     //! @brief Gets the channels buses layouts supported.
     static std::vector<buses_layout> const& getBusesLayouts();
     
@@ -156,7 +178,9 @@ private:
         init_auto_program = 13,
         init_auto_bypass  = 14,
         init_manufacturer = 15,
-        all = 16
+        init_voices       = 16,
+        init_pipeline     = 17,
+        all = 18
     };
     
     std::string     plugin_name = "Camomile";
@@ -181,9 +205,14 @@ private:
     bool    m_auto_reload     = false;
     bool    m_auto_program    = true;
     bool    m_auto_bypass     = true;
+    std::string m_voice_patch = "";
+    size_t  m_nvoices         = 0;
+    std::string m_pipeline_patch = "";
     
     std::vector<std::string>    m_programs;
     std::vector<std::string>    m_params;
+    std::vector<std::string>    m_saved_arrays;
+    std::vector<std::pair<std::string, std::string>> m_shared_arrays;
     std::vector<bus>            m_buses;
     std::vector<buses_layout>   m_buses_layouts;
     
@@ -5,10 +5,241 @@
 */
 
 #include "PluginFileWatcher.h"
+#include <algorithm>
 #include <iostream>
+#include <map>
 
+#if JUCE_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
+// ======================================================================================== //
+//                                      NOTIFIER                                            //
+// ======================================================================================== //
 
+#if JUCE_LINUX
 
+//! @brief The thread that receives the inotify events of the patch directory.
+//! @details The thread sleeps in poll() until an event occurs, so nothing runs while the\n
+//! files don't change. The pipe is only used to wake up the thread when it must exit.
+class CamomileFileWatcher::Notifier : public Thread
+{
+public:
+    Notifier(File const& directory, AsyncUpdater& owner) : Thread("Camomile File Watcher"), m_owner(owner)
+    {
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(m_fd < 0 || pipe2(m_wake, O_NONBLOCK | O_CLOEXEC) != 0)
+        {
+            return;
+        }
+        if(!addWatch(directory))
+        {
+            return;
+        }
+        for(auto const& child : directory.findChildFiles(File::findDirectories, true))
+        {
+            addWatch(child);
+        }
+        m_valid = true;
+        startThread();
+    }
 
+    ~Notifier()
+    {
+        signalThreadShouldExit();
+        if(m_wake[1] >= 0)
+        {
+            char const byte = 0;
+            ssize_t const result = write(m_wake[1], &byte, 1);
+            ignoreUnused(result);
+        }
+        stopThread(1000);
+        if(m_fd >= 0) { close(m_fd); }
+        if(m_wake[0] >= 0) { close(m_wake[0]); }
+        if(m_wake[1] >= 0) { close(m_wake[1]); }
+    }
 
+    bool isValid() const noexcept { return m_valid; }
+
+    void run() override
+    {
+        bool pending = false;
+        while(!threadShouldExit())
+        {
+            pollfd fds[2] = {{m_fd, POLLIN, 0}, {m_wake[0], POLLIN, 0}};
+            int const result = poll(fds, 2, pending ? debounce_ms : -1);
+            if(threadShouldExit())
+            {
+                return;
+            }
+            if(result == 0 && pending)
+            {
+                pending = false;
+                m_owner.triggerAsyncUpdate();
+            }
+            else if(result > 0 && (fds[0].revents & POLLIN))
+            {
+                pending = readEvents() || pending;
+            }
+        }
+    }
+
+private:
+    bool addWatch(File const& directory)
+    {
+        uint32_t const mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+        int const wd = inotify_add_watch(m_fd, directory.getFullPathName().toRawUTF8(), mask);
+        if(wd >= 0)
+        {
+            m_directories[wd] = directory;
+            return true;
+        }
+        return false;
+    }
+
+    //! @brief Reads the pending events and returns true if a patch changed.
+    bool readEvents()
+    {
+        bool changed = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t size;
+        while((size = read(m_fd, buffer, sizeof(buffer))) > 0)
+        {
+            for(char* ptr = buffer; ptr < buffer + size;)
+            {
+                inotify_event const* event = reinterpret_cast<inotify_event const*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+                if(event->mask & IN_Q_OVERFLOW)
+                {
+                    changed = true;
+                }
+                else if(event->len > 0)
+                {
+                    String const name(CharPointer_UTF8(event->name));
+                    if(event->mask & IN_ISDIR)
+                    {
+                        auto it = m_directories.find(event->wd);
+                        if(it != m_directories.end() && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                        {
+                            addWatch(it->second.getChildFile(name));
+                        }
+                    }
+                    else if(name.endsWithIgnoreCase(".pd"))
+                    {
+                        changed = true;
+                    }
+                }
+            }
+        }
+        return changed;
+    }
+
+    AsyncUpdater&        m_owner;
+    int                  m_fd = -1;
+    int                  m_wake[2] = {-1, -1};
+    bool                 m_valid = false;
+    std::map<int, File>  m_directories;
+};
+
+#else
+
+class CamomileFileWatcher::Notifier
+{
+public:
+    Notifier(File const&, AsyncUpdater&) {}
+    bool isValid() const noexcept { return false; }
+};
+
+#endif
+
+// ======================================================================================== //
+//                                      FILE WATCHER                                        //
+// ======================================================================================== //
+
+CamomileFileWatcher::CamomileFileWatcher() :
+m_directory(CamomileEnvironment::getPatchPath())
+{
+    if(CamomileEnvironment::wantsAutoReload())
+    {
+        File const patch(m_directory.getChildFile(CamomileEnvironment::getPatchName()));
+        if(patch.exists())
+        {
+            m_notifier = std::make_unique<Notifier>(m_directory, *this);
+            if(!m_notifier->isValid())
+            {
+                m_notifier.reset();
+                scanFiles();
+                m_time = getLastModificationTime();
+                startTimer(debounce_ms);
+            }
+        }
+    }
+}
+
+CamomileFileWatcher::~CamomileFileWatcher()
+{
+    stopTimer();
+    m_notifier.reset();
+    cancelPendingUpdate();
+}
+
+bool CamomileFileWatcher::scanFiles()
+{
+    m_directories.clear();
+    m_directories.emplace_back(m_directory, m_directory.getLastModificationTime());
+    for(auto const& child : m_directory.findChildFiles(File::findDirectories, true))
+    {
+        m_directories.emplace_back(child, child.getLastModificationTime());
+    }
+    std::vector<File> files;
+    for(auto const& file : m_directory.findChildFiles(File::findFiles, true, "*.pd"))
+    {
+        files.push_back(file);
+    }
+    std::sort(files.begin(), files.end());
+    bool const changed = files != m_files;
+    m_files = std::move(files);
+    return changed;
+}
+
+bool CamomileFileWatcher::directoriesChanged() const
+{
+    return std::any_of(m_directories.begin(), m_directories.end(), [](std::pair<File, Time> const& directory)
+    {
+        return directory.first.getLastModificationTime() != directory.second;
+    });
+}
+
+Time CamomileFileWatcher::getLastModificationTime() const
+{
+    Time time;
+    for(auto const& file : m_files)
+    {
+        time = std::max(time, file.getLastModificationTime());
+    }
+    return time;
+}
+
+void CamomileFileWatcher::timerCallback()
+{
+    bool const listed = directoriesChanged() && scanFiles();
+    Time const ntime = getLastModificationTime();
+    if(listed || ntime != m_time)
+    {
+        m_time = ntime;
+        m_pending = true;
+    }
+    else if(m_pending)
+    {
+        m_pending = false;
+        fileChanged();
+    }
+}
+
+void CamomileFileWatcher::handleAsyncUpdate()
+{
+    fileChanged();
+}
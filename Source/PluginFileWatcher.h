@@ -8,46 +8,45 @@
 
 #include <JuceHeader.h>
 #include "PluginConfig.h"
+#include <memory>
+#include <utility>
+#include <vector>
 
 // ======================================================================================== //
 //                                      FILE WATCHER                                        //
 // ======================================================================================== //
 
-class CamomileFileWatcher : public Timer
+//! @brief The class watches the patch directory and notifies when a patch changed.
+//! @details The whole directory of the patch is watched so editing an abstraction also\n
+//! notifies. On Linux, the class uses inotify on a background thread, otherwise it polls\n
+//! the modification times of the patch files. The list of the patch files is cached and\n
+//! the directories are only scanned again when the modification time of one of them\n
+//! changes (a file has been added, removed or renamed). In both cases, a burst of changes\n
+//! is debounced and fileChanged() is called once on the message thread.
+class CamomileFileWatcher : private Timer, private AsyncUpdater
 {
 public:
-    CamomileFileWatcher() :
-    m_file(CamomileEnvironment::getPatchPath() + File::getSeparatorString() + CamomileEnvironment::getPatchName())
-    {
-        if(CamomileEnvironment::wantsAutoReload())
-        {
-            if(m_file.exists())
-            {
-                m_time = m_file.getLastModificationTime();
-                startTimer(100);
-            }
-        }
-    }
-    
-    virtual ~CamomileFileWatcher() {}
-    
-    void timerCallback()
-    {
-        if(m_file.exists())
-        {
-            Time const ntime = m_file.getLastModificationTime();
-            if(ntime != m_time)
-            {
-                m_time = ntime;
-                fileChanged();
-            }
-        }
-    }
-    
+    CamomileFileWatcher();
+    virtual ~CamomileFileWatcher();
+
     virtual void fileChanged() = 0;
-    
+
 private:
-    File const m_file;
-    Time m_time;
-};
+    void timerCallback() final;
+    void handleAsyncUpdate() final;
+    //! @brief Scans the directories and returns true if the list of the patch files changed.
+    bool scanFiles();
+    //! @brief Returns true if a file has been added, removed or renamed in a directory.
+    bool directoriesChanged() const;
+    Time getLastModificationTime() const;
 
+    static const int debounce_ms = 250;
+
+    class Notifier;
+    File const                m_directory;
+    std::vector<std::pair<File, Time>> m_directories;
+    std::vector<File>         m_files;
+    Time                      m_time;
+    bool                      m_pending = false;
+    std::unique_ptr<Notifier> m_notifier;
+};
@@ -0,0 +1,436 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginJobs.h"
+#include "PluginEnvironment.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+// ======================================================================================== //
+//                                          JOBS                                            //
+// ======================================================================================== //
+
+CamomileJobs::Pool::Pool()
+{
+    size_t const nthreads = static_cast<size_t>(jlimit(1, 4, SystemStats::getNumCpus() - 1));
+    for(size_t i = 0; i < nthreads; ++i)
+    {
+        m_threads.emplace_back(&Pool::run, this);
+    }
+}
+
+CamomileJobs::Pool::~Pool()
+{
+    m_running = false;
+    notify();
+    for(auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+std::shared_ptr<CamomileJobs::Pool> CamomileJobs::Pool::get()
+{
+    static std::mutex mutex;
+    static std::weak_ptr<Pool> instance;
+    std::lock_guard<std::mutex> guard(mutex);
+    auto pool = instance.lock();
+    if(!pool)
+    {
+        pool = std::make_shared<Pool>();
+        instance = pool;
+    }
+    return pool;
+}
+
+void CamomileJobs::Pool::attach(CamomileJobs* jobs)
+{
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+    m_jobs.push_back(jobs);
+}
+
+void CamomileJobs::Pool::detach(CamomileJobs* jobs)
+{
+    // the exclusive lock waits for the jobs in progress
+    std::unique_lock<std::shared_mutex> guard(m_mutex);
+    m_jobs.erase(std::remove(m_jobs.begin(), m_jobs.end(), jobs), m_jobs.end());
+}
+
+void CamomileJobs::Pool::notify()
+{
+    m_pending.fetch_add(1, std::memory_order_release);
+    m_pending.notify_all();
+}
+
+void CamomileJobs::Pool::run()
+{
+    while(m_running)
+    {
+        // the counter is read before the queues so a job added meanwhile wakes the thread
+        uint32_t const pending = m_pending.load(std::memory_order_acquire);
+        {
+            std::shared_lock<std::shared_mutex> guard(m_mutex);
+            for(auto* jobs : m_jobs)
+            {
+                jobs->performPending();
+            }
+        }
+        if(m_running)
+        {
+            m_pending.wait(pending);
+        }
+    }
+}
+
+CamomileJobs::CamomileJobs(pd::Instance& owner) : m_owner(owner), m_pool(Pool::get())
+{
+    m_pool->attach(this);
+    m_attached = true;
+}
+
+CamomileJobs::~CamomileJobs()
+{
+    stopThreads();
+    swap s;
+    while(m_swaps.try_dequeue(s) || m_garbage.try_dequeue(s))
+    {
+        release(s);
+    }
+}
+
+void CamomileJobs::stopThreads()
+{
+    if(m_attached)
+    {
+        // the threads stop after their current job
+        m_running = false;
+        m_pool->detach(this);
+        m_attached = false;
+        m_running = true;
+    }
+}
+
+bool CamomileJobs::add(std::string const& receiver, std::string const& type, std::vector<pd::Atom> const& arguments)
+{
+    if(m_queue.try_enqueue(job{receiver, type, arguments}))
+    {
+        m_pool->notify();
+        return true;
+    }
+    return false;
+}
+
+void CamomileJobs::performPending()
+{
+    job j;
+    swap s;
+    while(m_garbage.try_dequeue(s))
+    {
+        release(s);
+    }
+    while(m_running && m_queue.try_dequeue(j))
+    {
+        perform(j);
+    }
+}
+
+void CamomileJobs::release(swap& s)
+{
+    for(size_t i = 0; i < s.vectors.size(); ++i)
+    {
+        pd::Array::release(s.vectors[i], s.sizes[i]);
+    }
+    s.vectors.clear();
+}
+
+void CamomileJobs::processTick()
+{
+    swap s;
+    while(m_swaps.try_dequeue(s))
+    {
+        // the vectors are replaced by the previous ones and freed by the pool
+        bool valid = true;
+        for(size_t i = 0; i < s.arrays.size(); ++i)
+        {
+            valid = m_owner.getArray(s.arrays[i]).swap(s.vectors[i], s.sizes[i]) && valid;
+        }
+        if(valid)
+        {
+            m_owner.sendMessage(s.receiver.c_str(), "done", s.result);
+        }
+        else
+        {
+            m_owner.sendMessage(s.receiver.c_str(), "error", {"an array doesn't exist or is shared"});
+        }
+        if(!m_garbage.try_enqueue(std::move(s)))
+        {
+            release(s);
+        }
+        m_pool->notify();
+    }
+}
+
+void CamomileJobs::reply(std::string const& receiver, std::string const& message, std::vector<pd::Atom>&& list)
+{
+    // the queue is emptied at each tick so the job waits for room instead of losing messages
+    for(int i = 0; i < reply_timeout && m_running; ++i)
+    {
+        if(m_owner.enqueueMessages(receiver, message, std::vector<pd::Atom>(list)))
+        {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    throw std::string("the queue of the messages is full");
+}
+
+void CamomileJobs::fail(std::string const& receiver, std::string const& message) noexcept
+{
+    try
+    {
+        reply(receiver, "error", {message});
+    }
+    catch(...)
+    {
+        std::cerr << "camomile job " << receiver << ": " << message << "\n";
+    }
+}
+
+std::string CamomileJobs::getSymbol(job const& j, size_t index)
+{
+    if(index >= j.arguments.size() || !j.arguments[index].isSymbol())
+    {
+        throw std::string("argument ") + std::to_string(index + 1) + " must be a symbol";
+    }
+    return j.arguments[index].getSymbol();
+}
+
+File CamomileJobs::getFile(job const& j, size_t index)
+{
+    std::string const path = getSymbol(j, index);
+    return File::isAbsolutePath(path) ? File(path) : File(CamomileEnvironment::getPatchPath()).getChildFile(path);
+}
+
+void CamomileJobs::perform(job const& j)
+{
+    try
+    {
+        if(j.type == "text")
+        {
+            performText(j);
+        }
+        else if(j.type == "spectrum")
+        {
+            performSpectrum(j);
+        }
+        else if(j.type == "harmonics")
+        {
+            performHarmonics(j);
+        }
+        else if(j.type == "soundfile")
+        {
+            // the message is sent when the arrays are swapped
+            performSoundfile(j);
+            return;
+        }
+        else
+        {
+            throw std::string("unknown type ") + j.type;
+        }
+        reply(j.receiver, "done");
+    }
+    catch(std::string const& message)
+    {
+        fail(j.receiver, message);
+    }
+    catch(std::exception const& e)
+    {
+        fail(j.receiver, std::string(e.what()));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          TYPES                                           //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+void CamomileJobs::performText(job const& j)
+{
+    File const file = getFile(j, 0);
+    if(!file.existsAsFile())
+    {
+        throw std::string("can't find the file ") + file.getFullPathName().toStdString();
+    }
+    StringArray lines;
+    file.readLines(lines);
+    for(auto const& line : lines)
+    {
+        std::vector<pd::Atom> atoms;
+        for(auto const& token : StringArray::fromTokens(line, true))
+        {
+            if(token.containsOnly("0123456789.-+eE") && token.containsAnyOf("0123456789"))
+            {
+                atoms.push_back(token.getFloatValue());
+            }
+            else
+            {
+                atoms.push_back(token.toStdString());
+            }
+        }
+        if(!atoms.empty())
+        {
+            reply(j.receiver, "line", std::move(atoms));
+        }
+    }
+}
+
+void CamomileJobs::performSpectrum(job const& j)
+{
+    std::vector<float> values;
+    m_owner.getArray(getSymbol(j, 0)).read(values);
+    size_t n = 1;
+    while(n * 2 <= values.size())
+    {
+        n *= 2;
+    }
+    if(n < 2)
+    {
+        throw std::string("the source array is too small");
+    }
+
+    // Hann window then an iterative radix-2 FFT
+    std::vector<std::complex<double>> bins(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        double const window = 0.5 - 0.5 * std::cos(2. * MathConstants<double>::pi * static_cast<double>(i) / static_cast<double>(n));
+        bins[i] = static_cast<double>(values[i]) * window;
+    }
+    for(size_t i = 1, k = 0; i < n; ++i)
+    {
+        size_t bit = n >> 1;
+        for(; k & bit; bit >>= 1) { k ^= bit; }
+        k ^= bit;
+        if(i < k) { std::swap(bins[i], bins[k]); }
+    }
+    for(size_t length = 2; length <= n; length <<= 1)
+    {
+        double const angle = -2. * MathConstants<double>::pi / static_cast<double>(length);
+        std::complex<double> const step(std::cos(angle), std::sin(angle));
+        for(size_t i = 0; i < n; i += length)
+        {
+            std::complex<double> w(1.);
+            for(size_t k = 0; k < length / 2; ++k)
+            {
+                auto const even = bins[i + k];
+                auto const odd = bins[i + k + length / 2] * w;
+                bins[i + k] = even + odd;
+                bins[i + k + length / 2] = even - odd;
+                w *= step;
+            }
+        }
+    }
+
+    std::vector<float> magnitudes(n / 2);
+    for(size_t i = 0; i < magnitudes.size(); ++i)
+    {
+        magnitudes[i] = static_cast<float>(std::abs(bins[i]) * 4. / static_cast<double>(n));
+    }
+    m_owner.getArray(getSymbol(j, 1)).write(magnitudes);
+}
+
+void CamomileJobs::performHarmonics(job const& j)
+{
+    auto array = m_owner.getArray(getSymbol(j, 0));
+    std::vector<float> values;
+    array.read(values);
+    std::vector<double> sum(values.size(), 0.);
+    for(size_t h = 1; h < j.arguments.size(); ++h)
+    {
+        if(!j.arguments[h].isFloat())
+        {
+            throw std::string("the amplitudes must be floats");
+        }
+        double const amplitude = static_cast<double>(j.arguments[h].getFloat());
+        double const increment = 2. * MathConstants<double>::pi * static_cast<double>(h) / static_cast<double>(values.size());
+        for(size_t i = 0; i < sum.size() && amplitude != 0.; ++i)
+        {
+            sum[i] += amplitude * std::sin(increment * static_cast<double>(i));
+        }
+    }
+    double peak = 0.;
+    for(auto const value : sum)
+    {
+        peak = std::max(peak, std::abs(value));
+    }
+    for(size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = static_cast<float>(peak > 0. ? sum[i] / peak : 0.);
+    }
+    array.write(values);
+}
+
+void CamomileJobs::performSoundfile(job const& j)
+{
+    File const file = getFile(j, 0);
+    if(!file.existsAsFile())
+    {
+        throw std::string("can't find the file ") + file.getFullPathName().toStdString();
+    }
+    if(j.arguments.size() < 2)
+    {
+        throw std::string("needs at least one array");
+    }
+    AudioFormatManager manager;
+    manager.registerBasicFormats();
+    std::unique_ptr<AudioFormatReader> reader(manager.createReaderFor(file));
+    if(reader == nullptr)
+    {
+        throw std::string("can't decode the file ") + file.getFullPathName().toStdString();
+    }
+    if(reader->lengthInSamples < 1 || reader->lengthInSamples > static_cast<int64>(std::numeric_limits<int>::max()))
+    {
+        throw std::string("the length of the file is not supported");
+    }
+    int const nframes = static_cast<int>(reader->lengthInSamples);
+    int const nchannels = static_cast<int>(reader->numChannels);
+    AudioBuffer<float> buffer(nchannels, nframes);
+    if(!reader->read(&buffer, 0, nframes, 0, true, true))
+    {
+        throw std::string("can't read the file ") + file.getFullPathName().toStdString();
+    }
+
+    // Each array receives a channel, the last channel is used if there are more arrays.
+    swap s;
+    s.receiver = j.receiver;
+    s.result = {static_cast<float>(nframes), static_cast<float>(reader->sampleRate)};
+    std::vector<float> values(static_cast<size_t>(nframes));
+    try
+    {
+        for(size_t i = 1; i < j.arguments.size(); ++i)
+        {
+            auto const channel = std::min(static_cast<int>(i) - 1, nchannels - 1);
+            std::copy_n(buffer.getReadPointer(channel), nframes, values.data());
+            s.arrays.push_back(getSymbol(j, i));
+            s.vectors.push_back(pd::Array::allocate(values));
+            s.sizes.push_back(values.size());
+        }
+    }
+    catch(...)
+    {
+        release(s);
+        throw;
+    }
+    if(!m_swaps.try_enqueue(std::move(s)))
+    {
+        release(s);
+        throw std::string("too many sound files pending");
+    }
+}
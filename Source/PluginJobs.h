@@ -0,0 +1,131 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Pd/PdInstance.hpp"
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+// ======================================================================================== //
+//                                          JOBS                                            //
+// ======================================================================================== //
+
+//! @brief Performs the blocking jobs requested by the patch on a pool of threads shared by\n
+//! all the instances.
+//! @details The patch requests a job with the message "job <receiver> <type> <arguments>"\n
+//! sent to camomile. The jobs are performed outside the audio thread and their results are\n
+//! sent to the receiver at the beginning of a tick. Each job ends with the message "done"\n
+//! or with the message "error <description>". The types of job are:\n
+//! - text <file>: reads a text file and sends each line with the message "line".\n
+//! - spectrum <source> <destination>: writes the magnitudes of the spectrum of the source\n
+//! array in the destination array.\n
+//! - harmonics <array> <amplitudes...>: fills the array with the sum of the harmonics.\n
+//! - soundfile <file> <arrays...>: decodes a sound file, the arrays are resized and filled\n
+//! between two ticks by swapping their vectors and "done <frames> <sample rate>" is sent\n
+//! within the same tick. The swap doesn't copy the values but, like a resize, it redraws\n
+//! the arrays and rebuilds the DSP chain if they're used by the DSP, so its cost depends on\n
+//! the patch.\n
+//! The relative paths of the files are relative to the folder of the patch.
+class CamomileJobs
+{
+public:
+    CamomileJobs(pd::Instance& owner);
+    ~CamomileJobs();
+
+    //! @brief Adds a job to the queue, returns false if the queue is full.
+    //! @details The method can be called by the audio thread.
+    bool add(std::string const& receiver, std::string const& type, std::vector<pd::Atom> const& arguments);
+    
+    //! @brief Stops performing the jobs with the threads of the pool.
+    //! @details The jobs are then only performed by performPending(), the method is used\n
+    //! when the host provides its own worker thread.
+    void stopThreads();
+    
+    //! @brief Performs the jobs pending on the calling thread.
+    void performPending();
+    
+    //! @brief Swaps the arrays of the sound files decoded and sends their messages.
+    //! @details The method must be called by the audio thread between two ticks, it doesn't\n
+    //! throw and the arrays that can't be swapped are reported to the receiver.
+    void processTick();
+
+private:
+    struct job
+    {
+        std::string         receiver;
+        std::string         type;
+        std::vector<pd::Atom> arguments;
+    };
+
+    //! @brief The vectors that replace the vectors of the arrays (the previous vectors\n
+    //! after the swap).
+    struct swap
+    {
+        std::string              receiver;
+        std::vector<std::string> arrays;
+        std::vector<void*>       vectors;
+        std::vector<size_t>      sizes;
+        std::vector<pd::Atom>    result;
+    };
+
+    //! @brief The threads shared by all the instances of the process.
+    //! @details The pool is created with the first instance and destroyed with the last\n
+    //! one. The instances are registered in the pool while their jobs can be performed by\n
+    //! its threads, an instance is unregistered once the jobs in progress are done.
+    class Pool
+    {
+    public:
+        Pool();
+        ~Pool();
+        void attach(CamomileJobs* jobs);
+        void detach(CamomileJobs* jobs);
+        void notify();
+        static std::shared_ptr<Pool> get();
+    private:
+        void run();
+        std::vector<std::thread>    m_threads;
+        std::vector<CamomileJobs*>  m_jobs;
+        std::shared_mutex           m_mutex;
+        std::atomic<uint32_t>       m_pending {0};
+        std::atomic<bool>           m_running {true};
+    };
+
+    void release(swap& s);
+    void perform(job const& j);
+    //! @brief Sends a message to the receiver at the next tick.
+    //! @details If the queue of the messages is full, the thread waits until the queue is\n
+    //! emptied by the next ticks and throws if the queue is still full after reply_timeout.
+    void reply(std::string const& receiver, std::string const& message, std::vector<pd::Atom>&& list = {});
+    //! @brief Sends an error to the receiver or prints it if it can't be sent.
+    void fail(std::string const& receiver, std::string const& message) noexcept;
+
+    void performText(job const& j);
+    void performSpectrum(job const& j);
+    void performHarmonics(job const& j);
+    void performSoundfile(job const& j);
+
+    static std::string getSymbol(job const& j, size_t index);
+    
+    //! @brief The maximum time waited for room in the queue of the messages (in ms).
+    static const int reply_timeout = 1000;
+    //! @brief Gets the file of an argument, a relative path is relative to the patch folder.
+    static File getFile(job const& j, size_t index);
+
+    pd::Instance&                   m_owner;
+    std::shared_ptr<Pool>           m_pool;
+    moodycamel::ConcurrentQueue<job> m_queue = moodycamel::ConcurrentQueue<job>(256);
+    moodycamel::ConcurrentQueue<swap> m_swaps = moodycamel::ConcurrentQueue<swap>(64);
+    moodycamel::ConcurrentQueue<swap> m_garbage = moodycamel::ConcurrentQueue<swap>(64);
+    bool                            m_attached = false;
+    std::atomic<bool>               m_running {true};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CamomileJobs)
+};
@@ -0,0 +1,115 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginLoad.h"
+#include <algorithm>
+#include <cmath>
+
+// ======================================================================================== //
+//                                          LOAD                                            //
+// ======================================================================================== //
+
+CamomileLoadMeter::CamomileLoadMeter() noexcept
+{
+    m_histogram.fill(0);
+    for(auto& value : m_published)
+    {
+        value.store(0.f, std::memory_order_relaxed);
+    }
+}
+
+void CamomileLoadMeter::add(double duration, double budget) noexcept
+{
+    double const us = duration * 1000000.;
+    double const ratio = budget > 0. ? duration / budget : 0.;
+    m_min = m_count ? std::min(m_min, us) : us;
+    m_max = m_count ? std::max(m_max, us) : us;
+    m_sum += us;
+    m_load_sum += ratio;
+    m_load_max = std::max(m_load_max, ratio);
+    ++m_count;
+    
+    int const index = us > bucket_origin ? static_cast<int>(std::log2(us / bucket_origin) * 4.) : 0;
+    ++m_histogram[static_cast<size_t>(std::min(index, static_cast<int>(nbuckets) - 1))];
+}
+
+float CamomileLoadMeter::getPercentile(double ratio) const noexcept
+{
+    size_t const threshold = static_cast<size_t>(std::ceil(ratio * static_cast<double>(m_count)));
+    size_t total = 0;
+    for(size_t i = 0; i < nbuckets; ++i)
+    {
+        total += m_histogram[i];
+        if(total >= threshold)
+        {
+            // the upper bound of the bucket is bounded by the max of the window
+            double const upper = bucket_origin * std::exp2(static_cast<double>(i + 1) / 4.);
+            return static_cast<float>(std::min(upper, m_max));
+        }
+    }
+    return static_cast<float>(m_max);
+}
+
+void CamomileLoadMeter::publish() noexcept
+{
+    if(m_count == 0)
+    {
+        return;
+    }
+    float const values[nvalues] = {
+        static_cast<float>(m_min),
+        static_cast<float>(m_sum / static_cast<double>(m_count)),
+        static_cast<float>(m_max),
+        getPercentile(0.5),
+        getPercentile(0.9),
+        getPercentile(0.99),
+        static_cast<float>(m_load_sum / static_cast<double>(m_count)),
+        static_cast<float>(m_load_max)};
+    m_sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for(size_t i = 0; i < nvalues; ++i)
+    {
+        m_published[i].store(values[i], std::memory_order_relaxed);
+    }
+    m_sequence.fetch_add(1, std::memory_order_release);
+    
+    m_min = m_max = m_sum = m_load_sum = m_load_max = 0.;
+    m_count = 0;
+    m_histogram.fill(0);
+}
+
+CamomileLoadMeter::statistics CamomileLoadMeter::get() const noexcept
+{
+    // the values are read again if a window has been published meanwhile
+    float values[nvalues];
+    while(true)
+    {
+        uint32_t const sequence = m_sequence.load(std::memory_order_acquire);
+        if(sequence & 1)
+        {
+            continue;
+        }
+        for(size_t i = 0; i < nvalues; ++i)
+        {
+            values[i] = m_published[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(m_sequence.load(std::memory_order_relaxed) == sequence)
+        {
+            break;
+        }
+    }
+    statistics stats;
+    stats.min  = values[0];
+    stats.mean = values[1];
+    stats.max  = values[2];
+    stats.p50  = values[3];
+    stats.p90  = values[4];
+    stats.p99  = values[5];
+    stats.load = values[6];
+    stats.peak = values[7];
+    return stats;
+}
@@ -0,0 +1,72 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// ======================================================================================== //
+//                                          LOAD                                            //
+// ======================================================================================== //
+
+//! @brief Measures the time spent to process the audio.
+//! @details The durations are accumulated by the audio thread in a window with a\n
+//! logarithmic histogram (four buckets per octave from 0.1 microseconds). When the window\n
+//! is published, its statistics are stored in atomic values protected by a sequence that\n
+//! is odd while they are written, so any thread can read the statistics of a single window\n
+//! without lock, and a new window starts.
+class CamomileLoadMeter
+{
+public:
+    //! @brief The statistics of a window, the durations are in microseconds.
+    struct statistics
+    {
+        float min  = 0.f;
+        float mean = 0.f;
+        float max  = 0.f;
+        float p50  = 0.f;
+        float p90  = 0.f;
+        float p99  = 0.f;
+        float load = 0.f;   //!< The mean ratio between the duration and the real-time budget.
+        float peak = 0.f;   //!< The max ratio between the duration and the real-time budget.
+    };
+    
+    CamomileLoadMeter() noexcept;
+    
+    //! @brief Adds a duration and its real-time budget (in seconds) to the window.
+    //! @details The method must be called by the audio thread.
+    void add(double duration, double budget) noexcept;
+    
+    //! @brief Publishes the statistics of the window and starts a new one.
+    //! @details The method must be called by the audio thread.
+    void publish() noexcept;
+    
+    //! @brief Gets the statistics of the last published window.
+    statistics get() const noexcept;
+    
+private:
+    float getPercentile(double ratio) const noexcept;
+    
+    static const size_t nbuckets = 96;
+    static constexpr double bucket_origin = 0.1;
+    
+    // The window, only accessed by the audio thread
+    double m_min       = 0.;
+    double m_max       = 0.;
+    double m_sum       = 0.;
+    double m_load_sum  = 0.;
+    double m_load_max  = 0.;
+    size_t m_count     = 0;
+    std::array<uint32_t, nbuckets> m_histogram;
+    
+    // The statistics published (in the order of the fields of the structure)
+    static const size_t nvalues = 8;
+    std::array<std::atomic<float>, nvalues> m_published;
+    std::atomic<uint32_t>                   m_sequence {0};
+};
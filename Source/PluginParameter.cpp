@@ -53,6 +53,11 @@ float CamomileAudioParameter::getValue() const
 void CamomileAudioParameter::setValue(float newValue)
 {
     m_value = convertFrom0to1(newValue);
+    if(m_changes)
+    {
+        auto const index = static_cast<uint64>(getParameterIndex());
+        m_changes[index >> 6].fetch_or(uint64(1) << (index & 63));
+    }
 }
 
 float CamomileAudioParameter::getDefaultValue() const
@@ -212,28 +217,23 @@ CamomileAudioParameter* CamomileAudioParameter::parse(const std::string& definit
     }
 }
 
-void CamomileAudioParameter::saveStateInformation(XmlElement& xml, Array<AudioProcessorParameter*> const& parameters)
+void CamomileAudioParameter::saveStateInformation(std::vector<float>& values, Array<AudioProcessorParameter*> const& parameters)
 {
-    XmlElement* params = xml.createNewChildElement("params");
-    if(params)
+    values.resize(static_cast<size_t>(parameters.size()));
+    for(int i = 0; i < parameters.size(); ++i)
     {
-        for(int i = 0; i < parameters.size(); ++i)
-        {
-            params->setAttribute(String("param") + String(i+1), static_cast<double>(parameters[i]->getValue()));
-        }
+        values[static_cast<size_t>(i)] = parameters[i]->getValue();
     }
 }
 
-void CamomileAudioParameter::loadStateInformation(XmlElement const& xml, Array<AudioProcessorParameter*> const& parameters)
+void CamomileAudioParameter::loadStateInformation(std::vector<float> const& values, Array<AudioProcessorParameter*> const& parameters)
 {
-    XmlElement const* params = xml.getChildByName(juce::StringRef("params"));
-    if(params)
+    for(int i = 0; i < parameters.size() && static_cast<size_t>(i) < values.size(); ++i)
     {
-        for(int i = 0; i < parameters.size(); ++i)
+        // undefined values of the legacy states keep the current value
+        if(!std::isnan(values[static_cast<size_t>(i)]))
         {
-            const float navalue = static_cast<float>(params->getDoubleAttribute(String("param") + String(i+1),
-                                                                                static_cast<double>(parameters[i]->getValue())));
-            parameters[i]->setValueNotifyingHost(navalue);
+            parameters[i]->setValueNotifyingHost(values[static_cast<size_t>(i)]);
         }
     }
 }
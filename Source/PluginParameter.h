@@ -39,11 +39,18 @@ public:
     bool isAutomatable() const override;
     bool isMetaParameter() const override;
     
+    //! @brief Sets the words in which the parameter flags its changes.
+    //! @details The bit of the index of the parameter is set each time the value is set so\n
+    //! the processor only looks at the parameters that changed. The method must be called\n
+    //! after the parameter is added to the processor.
+    void setChangeFlags(std::atomic<uint64>* flags) noexcept { m_changes = flags; }
+    
     static CamomileAudioParameter* parse(const std::string& definition);
-    static void saveStateInformation(XmlElement& xml, Array<AudioProcessorParameter*> const& parameters);
-    static void loadStateInformation(XmlElement const& xml, Array<AudioProcessorParameter*> const& parameters);
+    static void saveStateInformation(std::vector<float>& values, Array<AudioProcessorParameter*> const& parameters);
+    static void loadStateInformation(std::vector<float> const& values, Array<AudioProcessorParameter*> const& parameters);
 private:
     std::atomic<float> m_value;
+    std::atomic<uint64>* m_changes = nullptr;
     NormalisableRange<float> const m_norm_range;
     
     float const m_default;
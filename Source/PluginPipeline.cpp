@@ -0,0 +1,251 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginPipeline.h"
+#include <algorithm>
+#include <thread>
+
+// ======================================================================================== //
+//                                          STAGE                                           //
+// ======================================================================================== //
+
+class CamomilePipeline::Stage : public pd::Instance
+{
+public:
+    Stage(pd::Instance& owner) : pd::Instance("camomile"), m_owner(owner) {}
+
+    void receivePrint(const std::string& message) override
+    {
+        m_owner.receivePrint(message);
+    }
+    
+    // The messages and the MIDI events are dequeued by the audio thread at the end of the
+    // tick, so the owner receives them as if they came from the main patch.
+    void receiveBang() override
+    {
+        m_owner.receiveBang();
+    }
+    
+    void receiveFloat(float num) override
+    {
+        m_owner.receiveFloat(num);
+    }
+    
+    void receiveSymbol(const std::string& symbol) override
+    {
+        m_owner.receiveSymbol(symbol);
+    }
+    
+    void receiveList(const std::vector<pd::Atom>& list) override
+    {
+        m_owner.receiveList(list);
+    }
+    
+    void receiveMessage(const std::string& msg, const std::vector<pd::Atom>& list) override
+    {
+        m_owner.receiveMessage(msg, list);
+    }
+    
+    void receiveNoteOn(const int channel, const int pitch, const int velocity) override
+    {
+        m_owner.receiveNoteOn(channel, pitch, velocity);
+    }
+    
+    void receiveControlChange(const int channel, const int controller, const int value) override
+    {
+        m_owner.receiveControlChange(channel, controller, value);
+    }
+    
+    void receiveProgramChange(const int channel, const int value) override
+    {
+        m_owner.receiveProgramChange(channel, value);
+    }
+    
+    void receivePitchBend(const int channel, const int value) override
+    {
+        m_owner.receivePitchBend(channel, value);
+    }
+    
+    void receiveAftertouch(const int channel, const int value) override
+    {
+        m_owner.receiveAftertouch(channel, value);
+    }
+    
+    void receivePolyAftertouch(const int channel, const int pitch, const int value) override
+    {
+        m_owner.receivePolyAftertouch(channel, pitch, value);
+    }
+    
+    void receiveMidiByte(const int port, const int byte) override
+    {
+        m_owner.receiveMidiByte(port, byte);
+    }
+private:
+    pd::Instance& m_owner;
+};
+
+// ======================================================================================== //
+//                                          WORKER                                          //
+// ======================================================================================== //
+
+class CamomilePipeline::Worker : public Thread
+{
+public:
+    Worker(CamomilePipeline& owner) : Thread("camomile pipeline"), m_owner(owner) {}
+    
+    void run() override
+    {
+        m_owner.run();
+    }
+private:
+    CamomilePipeline& m_owner;
+};
+
+// ======================================================================================== //
+//                                          PIPELINE                                        //
+// ======================================================================================== //
+
+CamomilePipeline::CamomilePipeline(pd::Instance& owner) : m_owner(owner)
+{
+
+}
+
+CamomilePipeline::~CamomilePipeline()
+{
+    close();
+}
+
+void CamomilePipeline::open(std::string const& path, std::string const& name, size_t nparameters)
+{
+    close();
+    m_stage = std::make_unique<Stage>(m_owner);
+    m_stage->openPatch(path, name);
+    m_stage->processMessages();
+    // each parameter is sent once per tick and the queue is emptied at each tick of the
+    // second stage, so it never contains more than the values of two ticks
+    m_parameters = std::make_unique<QueueParameters>(std::max(nparameters * 2, size_t(64)));
+    m_atoms_param.resize(2);
+    m_submitted = 0;
+    m_done = 0;
+    m_running = true;
+    m_thread = std::make_unique<Worker>(*this);
+    m_thread->startThread(10);
+    m_owner.setThis();
+}
+
+void CamomilePipeline::close()
+{
+    if(m_thread)
+    {
+        m_running = false;
+        ++m_submitted;
+        m_submitted.notify_one();
+        m_thread->stopThread(-1);
+        m_thread.reset();
+    }
+    m_stage.reset();
+    m_parameters.reset();
+    m_owner.setThis();
+}
+
+void CamomilePipeline::prepare(int nchannels, double samplerate)
+{
+    if(m_stage)
+    {
+        wait();
+        size_t const size = static_cast<size_t>(nchannels) * static_cast<size_t>(m_owner.getBlockSize());
+        m_inputs.assign(size, 0.f);
+        m_outputs.assign(size, 0.f);
+        m_stage->prepareDSP(nchannels, nchannels, samplerate);
+        m_stage->startDSP();
+        m_stage->processMessages();
+        m_owner.setThis();
+    }
+}
+
+void CamomilePipeline::release()
+{
+    if(m_stage)
+    {
+        wait();
+        m_stage->releaseDSP();
+        m_stage->processMessages();
+        m_owner.setThis();
+    }
+}
+
+void CamomilePipeline::sendParameter(float index, float value) noexcept
+{
+    if(m_stage)
+    {
+        m_parameters->try_enqueue({index, value});
+    }
+}
+
+void CamomilePipeline::sendParameters()
+{
+    std::pair<float, float> parameter;
+    while(m_parameters->try_dequeue(parameter))
+    {
+        m_atoms_param[0] = parameter.first;
+        m_atoms_param[1] = parameter.second;
+        m_stage->sendList("param", m_atoms_param);
+    }
+}
+
+void CamomilePipeline::processPrints()
+{
+    if(m_stage)
+    {
+        m_stage->processPrints();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          PERFORM                                         //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+void CamomilePipeline::run()
+{
+    uint32_t submitted = 0;
+    while(m_running)
+    {
+        m_submitted.wait(submitted);
+        submitted = m_submitted.load(std::memory_order_acquire);
+        if(m_running)
+        {
+            sendParameters();
+            m_stage->performDSP(m_inputs.data(), m_outputs.data());
+            m_done.store(submitted, std::memory_order_release);
+        }
+    }
+}
+
+void CamomilePipeline::wait() noexcept
+{
+    while(m_done.load(std::memory_order_acquire) != m_submitted.load(std::memory_order_relaxed))
+    {
+        std::this_thread::yield();
+    }
+}
+
+void CamomilePipeline::tick(float* buffer) noexcept
+{
+    if(!m_stage)
+    {
+        return;
+    }
+    // The second stage has processed the previous tick while the main patch processed this
+    // one, the buffers are exchanged and the second stage is started again.
+    wait();
+    std::copy(buffer, buffer + m_inputs.size(), m_inputs.data());
+    std::copy(m_outputs.begin(), m_outputs.end(), buffer);
+    // the messages and the MIDI events of the previous tick of the second stage
+    m_stage->processMessages();
+    m_stage->processMidi();
+    m_submitted.fetch_add(1, std::memory_order_release);
+    m_submitted.notify_one();
+}
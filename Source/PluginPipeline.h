@@ -0,0 +1,85 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Pd/PdInstance.hpp"
+#include "Queues/readerwriterqueue.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// ======================================================================================== //
+//                                          PIPELINE                                        //
+// ======================================================================================== //
+
+//! @brief Runs a second patch in series with the main patch on its own thread.
+//! @details The second stage opens its patch in its own Pd instance. At each tick, the\n
+//! outputs of the main patch are given to the second stage that processes them while the\n
+//! main patch processes the next tick, and the outputs of the previous tick of the second\n
+//! stage are returned. The pipeline adds one Pd block of latency. The thread of the second\n
+//! stage has the highest priority (real-time when the system allows it) because the audio\n
+//! thread waits for it. The messages and the MIDI events that the second stage sends to\n
+//! camomile are forwarded to the owner by the audio thread at the end of the next tick.
+class CamomilePipeline
+{
+public:
+    CamomilePipeline(pd::Instance& owner);
+    ~CamomilePipeline();
+
+    //! @brief Opens the patch of the second stage and starts its thread.
+    //! @details The number of parameters is used to preallocate the queue of the parameters.
+    void open(std::string const& path, std::string const& name, size_t nparameters);
+
+    //! @brief Stops the thread and closes the second stage.
+    void close();
+
+    //! @brief Gets if the second stage is opened.
+    bool isOpened() const noexcept { return m_stage != nullptr; }
+
+    //! @brief Prepares the DSP of the second stage.
+    void prepare(int nchannels, double samplerate);
+
+    //! @brief Releases the DSP of the second stage.
+    void release();
+
+    //! @brief Sends the value of a parameter to the second stage.
+    //! @details The value is queued and sent by the thread of the second stage before its\n
+    //! next tick, so the audio thread never waits for the lock of the second stage.
+    void sendParameter(float index, float value) noexcept;
+
+    //! @brief Gives the outputs of the main patch to the second stage and replaces them by\n
+    //! the outputs of the previous tick of the second stage.
+    //! @details The buffer has the same layout as the buffers given to performDSP.
+    void tick(float* buffer) noexcept;
+
+    //! @brief Forwards the prints of the second stage to the owner.
+    void processPrints();
+
+private:
+    class Stage;
+    class Worker;
+    typedef moodycamel::ReaderWriterQueue<std::pair<float, float>> QueueParameters;
+
+    void run();
+    void wait() noexcept;
+    void sendParameters();
+
+    pd::Instance&           m_owner;
+    std::unique_ptr<Stage>  m_stage;
+    std::unique_ptr<Worker> m_thread;
+    std::vector<float>      m_inputs;
+    std::vector<float>      m_outputs;
+    std::unique_ptr<QueueParameters> m_parameters;
+    std::vector<pd::Atom>   m_atoms_param;
+
+    std::atomic<uint32_t>   m_submitted {0};
+    std::atomic<uint32_t>   m_done {0};
+    std::atomic<bool>       m_running {false};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CamomilePipeline)
+};
@@ -8,8 +8,13 @@
 #include "PluginParameter.h"
 #include "PluginEditor.h"
 #include "PluginConfig.h"
+#include "PluginRealtime.h"
 
+#include <algorithm>
+#include <bit>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <exception>
 
 // ======================================================================================== //
@@ -29,24 +34,34 @@ m_programs(CamomileEnvironment::getPrograms())
 {
     add(ConsoleLevel::Normal, std::string("Camomile ") + std::string(JucePlugin_VersionString)
         + std::string(" for Pd ") + CamomileEnvironment::getPdVersion());
+    add(ConsoleLevel::Log, std::string("camomile: Pd ticks of ") + std::to_string(Instance::getBlockSize()) + std::string(" samples"));
     for(auto const& error : CamomileEnvironment::getErrors())
     {
         add(ConsoleLevel::Error, std::string("camomile ") + error);
-        std::cout << "error : " << error << "\n";
+        std::cerr << "error : " << error << "\n";
     }
     logBusesLayoutsInformation();
+    m_state_buffer.lists.reserve(64);
+    m_state_lists.resize(64);
+    for(auto& saved : m_state_lists)
+    {
+        saved.atoms.resize(32);
+    }
     if(CamomileEnvironment::isValid())
     {
         m_atoms_param.resize(2);
         m_atoms_playhead.reserve(3);
         m_atoms_playhead.resize(1);
+        m_atoms_load.resize(7);
         
         m_midi_buffer_in.ensureSize(2048);
         m_midi_buffer_out.ensureSize(2048);
         m_midi_buffer_temp.ensureSize(2048);
         
         prepareDSP(getTotalNumInputChannels(), getTotalNumOutputChannels(), getSampleRate());
-        setLatencySamples(CamomileEnvironment::getLatencySamples() + Instance::getBlockSize());
+        // the pipeline delays the outputs of one more block
+        int const nblocks = CamomileEnvironment::getPipelinePatchName().empty() ? 1 : 2;
+        setLatencySamples(CamomileEnvironment::getLatencySamples() + Instance::getBlockSize() * nblocks);
         
         auto const& params = CamomileEnvironment::getParams();
         for(size_t i = 0; i < params.size(); ++i)
@@ -71,12 +86,42 @@ m_programs(CamomileEnvironment::getPrograms())
         }
         m_params_states.resize(getParameters().size());
         std::fill(m_params_states.begin(), m_params_states.end(), false);
+        m_params_sent.resize(getParameters().size());
+        m_params_words = (static_cast<size_t>(getParameters().size()) + 63) / 64;
+        m_params_changed.reset(new std::atomic<uint64>[m_params_words]);
+        for(size_t i = 0; i < m_params_words; ++i)
+        {
+            m_params_changed[i] = ~uint64(0);
+        }
+        for(auto* param : getParameters())
+        {
+            static_cast<CamomileAudioParameter*>(param)->setChangeFlags(m_params_changed.get());
+        }
+        m_params_changes.reserve(256);
         openPatch(CamomileEnvironment::getPatchPath(), CamomileEnvironment::getPatchName());
         processMessages();
+        computeProgramSnapshots();
+        mapSharedArrays();
+        if(CamomileEnvironment::getNumVoices())
+        {
+            m_voices.open(CamomileEnvironment::getPatchPath(), CamomileEnvironment::getVoicePatchName(),
+                          CamomileEnvironment::getNumVoices());
+        }
+        if(!CamomileEnvironment::getPipelinePatchName().empty())
+        {
+            m_pipeline.open(CamomileEnvironment::getPatchPath(), CamomileEnvironment::getPipelinePatchName(),
+                            static_cast<size_t>(getParameters().size()));
+        }
     }
 }
 
 
+CamomileAudioProcessor::~CamomileAudioProcessor()
+{
+    // the vectors of the arrays must be restored before the patch is closed
+    unmapSharedArrays();
+}
+
 void CamomileAudioProcessor::setCurrentProgram(int index)
 {
     if(static_cast<size_t>(index) < m_programs.size())
@@ -84,12 +129,67 @@ void CamomileAudioProcessor::setCurrentProgram(int index)
         m_program_current = index;
         if(isSuspended())
         {
-            sendFloat("program", static_cast<float>(index+1));
+            processProgram(index);
             processMessages();
         }
         else
         {
-            enqueueMessages("program", "float", {static_cast<float>(index+1)});
+            m_program_pending = index;
+        }
+    }
+}
+
+void CamomileAudioProcessor::computeProgramSnapshots()
+{
+    auto const& parameters = getParameters();
+    size_t const nparameters = static_cast<size_t>(parameters.size());
+    m_program_snapshots.assign(m_programs.size(), std::vector<float>(nparameters));
+    if(m_programs.size() < 2)
+    {
+        for(size_t i = 0; i < nparameters; ++i)
+        {
+            m_program_snapshots[0][i] = parameters[static_cast<int>(i)]->getValue();
+        }
+        return;
+    }
+    std::vector<float> values(nparameters);
+    for(size_t i = 0; i < nparameters; ++i)
+    {
+        values[i] = parameters[static_cast<int>(i)]->getValue();
+    }
+    for(size_t p = 0; p < m_programs.size(); ++p)
+    {
+        sendFloat("program", static_cast<float>(p+1));
+        processMessages();
+        for(size_t i = 0; i < nparameters; ++i)
+        {
+            m_program_snapshots[p][i] = parameters[static_cast<int>(i)]->getValue();
+        }
+    }
+    sendFloat("program", static_cast<float>(m_program_current+1));
+    processMessages();
+    for(size_t i = 0; i < nparameters; ++i)
+    {
+        parameters[static_cast<int>(i)]->setValue(values[i]);
+    }
+}
+
+void CamomileAudioProcessor::processProgram(int index)
+{
+    // the snapshot is applied in one tick without messaging the patch, only the parameters
+    // that changed are notified and flagged so they are sent to the patch
+    if(static_cast<size_t>(index) >= m_program_snapshots.size())
+    {
+        return;
+    }
+    auto const& snapshot = m_program_snapshots[static_cast<size_t>(index)];
+    auto const& parameters = getParameters();
+    for(int i = 0; i < parameters.size() && static_cast<size_t>(i) < snapshot.size(); ++i)
+    {
+        float const value = snapshot[static_cast<size_t>(i)];
+        if(parameters[i]->getValue() != value)
+        {
+            parameters[i]->setValueNotifyingHost(value);
         }
     }
 }
@@ -113,6 +213,8 @@ void CamomileAudioProcessor::changeProgramName(int index, const String& newName)
 
 void CamomileAudioProcessor::fileChanged()
 {
+    // the reload always stays on the message thread, even with the worker of the host,
+    // because it locks the message manager and suspends the processing
     reloadPatch();
 }
 
@@ -126,7 +228,20 @@ void CamomileAudioProcessor::reloadPatch()
         const MessageManagerLock mmLock;
         getStateInformation(xml);
     }
+    unmapSharedArrays();
     openPatch(CamomileEnvironment::getPatchPath(), CamomileEnvironment::getPatchName());
+    mapSharedArrays();
+    if(m_voices.isOpened())
+    {
+        m_voices.open(CamomileEnvironment::getPatchPath(), CamomileEnvironment::getVoicePatchName(),
+                      CamomileEnvironment::getNumVoices());
+    }
+    if(m_pipeline.isOpened())
+    {
+        m_pipeline.open(CamomileEnvironment::getPatchPath(), CamomileEnvironment::getPipelinePatchName(),
+                        static_cast<size_t>(getParameters().size()));
+    }
+    computeProgramSnapshots();
     {
         const MessageManagerLock mmLock;
         setStateInformation(xml.getData(), static_cast<int>(xml.getSize()));
@@ -141,6 +256,78 @@ void CamomileAudioProcessor::reloadPatch()
     suspendProcessing(false);
 }
 
+//==============================================================================
+// The non real-time work performed by the worker of the host (LV2 worker extension)
+
+void CamomileAudioProcessor::useHostWorker()
+{
+    m_jobs.stopThreads();
+    m_work_host = true;
+}
+
+void CamomileAudioProcessor::scheduleWork(Scheduler scheduler, void* handle)
+{
+    uint32_t const work = m_work_pending.exchange(0);
+    if(work && !scheduler(handle, work))
+    {
+        m_work_pending.fetch_or(work);
+    }
+}
+
+bool CamomileAudioProcessor::scheduleState(const void* data, int sizeInBytes, Scheduler scheduler, void* handle)
+{
+    // only one state can be restored at a time, the others are restored synchronously
+    bool expected = false;
+    if(!m_work_restoring.compare_exchange_strong(expected, true))
+    {
+        return false;
+    }
+    {
+        // the state is parsed here because the paths can only be converted during the call
+        std::lock_guard<std::mutex> guard(m_state_mutex);
+        readState(m_work_state, data, sizeInBytes);
+    }
+    if(m_work_state.program >= 0)
+    {
+        // the program isn't kept so the buffer can't select it again
+        setCurrentProgram(m_work_state.program);
+        m_work_state.program = -1;
+        m_work_restoring = false;
+        return true;
+    }
+    if(!scheduler(handle, WorkRestore))
+    {
+        m_work_restoring = false;
+        return false;
+    }
+    return true;
+}
+
+void CamomileAudioProcessor::performWork(uint32_t work)
+{
+    if(work & WorkJobs)
+    {
+        m_jobs.performPending();
+    }
+    if(work & WorkRestore)
+    {
+        loadArrays(m_work_state);
+    }
+}
+
+void CamomileAudioProcessor::performWorkResponse(uint32_t work)
+{
+    if(work & WorkJobs)
+    {
+        m_jobs.processTick();
+    }
+    if(work & WorkRestore)
+    {
+        loadInformation(m_work_state);
+        m_work_restoring = false;
+    }
+}
+
 //==============================================================================
 
 void CamomileAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
@@ -155,6 +342,8 @@ void CamomileAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBloc
     m_audio_buffer_out.resize(nouts * blksize);
     std::fill(m_audio_buffer_out.begin(), m_audio_buffer_out.end(), 0.f);
     std::fill(m_audio_buffer_in.begin(), m_audio_buffer_in.end(), 0.f);
+    m_voices.prepare(static_cast<int>(nouts), sampleRate);
+    m_pipeline.prepare(static_cast<int>(nouts), sampleRate);
     m_midi_buffer_in.clear();
     m_midi_buffer_out.clear();
     m_midi_buffer_temp.clear();
@@ -163,14 +352,25 @@ void CamomileAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBloc
     m_midibyte_buffer[0] = 0;
     m_midibyte_buffer[1] = 0;
     m_midibyte_buffer[2] = 0;
+    std::fill(m_params_sent.begin(), m_params_sent.end(), std::numeric_limits<float>::quiet_NaN());
+    for(size_t i = 0; i < m_params_words; ++i)
+    {
+        m_params_changed[i] = ~uint64(0);
+    }
+    m_params_changes.clear();
+    m_load_samples = 0;
     startDSP();
     processMessages();
     processPrints();
+    m_state_processing = true;
 }
 
 void CamomileAudioProcessor::releaseResources()
 {
+    m_state_processing = false;
     releaseDSP();
+    m_voices.release();
+    m_pipeline.release();
     processMessages();
     m_audio_buffer_in.clear();
     m_audio_buffer_out.clear();
@@ -181,16 +381,60 @@ void CamomileAudioProcessor::releaseResources()
 
 void CamomileAudioProcessor::sendParameters()
 {
+    // only the parameters flagged since the last tick are compared with the values sent
     auto const& parameters = AudioProcessor::getParameters();
-    for(int i = 0; i < parameters.size(); ++i)
+    for(size_t w = 0; w < m_params_words; ++w)
     {
-        auto const* param = static_cast<CamomileAudioParameter const*>(parameters.getUnchecked(i));
-        m_atoms_param[0] = static_cast<float>(i+1);
-        m_atoms_param[1] = param->convertFrom0to1(param->getValue());
-        sendList("param", m_atoms_param);
+        uint64 flags = m_params_changed[w].exchange(0);
+        while(flags)
+        {
+            int const i = static_cast<int>(w * 64) + std::countr_zero(flags);
+            flags &= flags - 1;
+            if(i >= parameters.size())
+            {
+                break;
+            }
+            auto const* param = static_cast<CamomileAudioParameter const*>(parameters.getUnchecked(i));
+            float const value = param->getValue();
+            if(value != m_params_sent[static_cast<size_t>(i)])
+            {
+                m_params_sent[static_cast<size_t>(i)] = value;
+                float const converted = param->convertFrom0to1(value);
+                m_atoms_param[0] = static_cast<float>(i+1);
+                m_atoms_param[1] = converted;
+                sendList("param", m_atoms_param);
+                m_voices.sendList("param", m_atoms_param);
+                m_pipeline.sendParameter(static_cast<float>(i+1), converted);
+            }
+        }
     }
 }
 
+bool CamomileAudioProcessor::addParameterChange(int index, float value, int sample)
+{
+    if(index < 0 || index >= getParameters().size() || m_params_changes.size() == m_params_changes.capacity())
+    {
+        return false;
+    }
+    m_params_changes.push_back({sample, index, value});
+    return true;
+}
+
+void CamomileAudioProcessor::processParameterChanges(int end)
+{
+    // the changes before the end of the input of the tick are applied before the tick
+    auto const& parameters = AudioProcessor::getParameters();
+    auto it = m_params_changes.begin();
+    for(; it != m_params_changes.end() && it->sample < end; ++it)
+    {
+        // the change comes from the host so it isn't notified back, setValue() only flags
+        // the parameter so its value is sent to the patch
+        auto* param = static_cast<CamomileAudioParameter*>(parameters.getUnchecked(it->index));
+        param->setValue(param->convertTo0to1(it->value));
+    }
+    m_params_changes.erase(m_params_changes.begin(), it);
+}
+
 void CamomileAudioProcessor::sendPlayhead()
 {
     int const phl = CamomileEnvironment::getPlayHeadLevel();
@@ -237,6 +481,7 @@ void CamomileAudioProcessor::sendMidiBuffer()
     {
         for(auto it = m_midi_buffer_in.cbegin(); it != m_midi_buffer_in.cend(); ++it) {
             auto const message = (*it).getMessage();
+            m_voices.sendMidi(message);
             if(message.isNoteOn()) {
                 sendNoteOn(message.getChannel(), message.getNoteNumber(), message.getVelocity()); }
             else if(message.isNoteOff()) {
@@ -271,14 +516,133 @@ void CamomileAudioProcessor::sendMidiBuffer()
     }
 }
 
+void CamomileAudioProcessor::publishLoad()
+{
+    m_load_block.publish();
+    m_load_tick.publish();
+    m_load_dsp.publish();
+    if(m_load_report)
+    {
+        // the durations are sent in microseconds and the loads in percent
+        auto const send = [this](const char* name, CamomileLoadMeter::statistics const& stats)
+        {
+            m_atoms_load[0] = stats.min;
+            m_atoms_load[1] = stats.mean;
+            m_atoms_load[2] = stats.max;
+            m_atoms_load[3] = stats.p50;
+            m_atoms_load[4] = stats.p90;
+            m_atoms_load[5] = stats.p99;
+            m_atoms_load[6] = stats.load * 100.f;
+            sendMessage("cpu", name, m_atoms_load);
+        };
+        send("block", m_load_block.get());
+        send("tick", m_load_tick.get());
+        // the strings are formatted on the message thread
+        m_load_posted.store(true, std::memory_order_release);
+        m_notifier.triggerAsyncUpdate();
+    }
+}
+
+void CamomileAudioProcessor::postLoad()
+{
+    auto const format = [](const char* name, CamomileLoadMeter::statistics const& stats)
+    {
+        return std::string("camomile cpu ") + name
+        + ": mean " + String(stats.mean, 1).toStdString()
+        + " us, p99 " + String(stats.p99, 1).toStdString()
+        + " us, max " + String(stats.max, 1).toStdString()
+        + " us, load " + String(stats.load * 100.f, 1).toStdString()
+        + "%, peak " + String(stats.peak * 100.f, 1).toStdString() + "%";
+    };
+    add(ConsoleLevel::Normal, format("block", getBlockLoad()));
+    add(ConsoleLevel::Normal, format("tick", getTickLoad()));
+}
+
+void CamomileAudioProcessor::processProfiler()
+{
+    // The audio thread only polls the profiler, the report is built on the message thread
+    int const state = pollProfiler();
+    if(state == 0)
+    {
+        return;
+    }
+    m_profiling = false;
+    m_profile_state.store(state, std::memory_order_release);
+    m_notifier.triggerAsyncUpdate();
+}
+
+void CamomileAudioProcessor::writeProfilerReport(int state)
+{
+    if(state < 0)
+    {
+        add(ConsoleLevel::Error, "camomile profile: the DSP chain has been rebuilt during the profiling");
+        return;
+    }
+    if(getProfilerReport(m_profile_lines) <= 0 || m_profile_lines.empty())
+    {
+        add(ConsoleLevel::Error, "camomile profile: the report isn't available");
+        return;
+    }
+    // the report is always written in a file, only the summary is posted in the console
+    File const file = m_profile_file.empty() ?
+    File::getSpecialLocation(File::tempDirectory).getChildFile("camomile-profile.txt") :
+    File(CamomileEnvironment::getPatchPath()).getChildFile(m_profile_file);
+    std::ofstream stream(file.getFullPathName().toStdString());
+    if(!stream.is_open())
+    {
+        add(ConsoleLevel::Error, "camomile profile: can't write the report to " + file.getFullPathName().toStdString());
+        return;
+    }
+    for(auto const& line : m_profile_lines)
+    {
+        stream << line << "\n";
+    }
+    add(ConsoleLevel::Normal, "camomile " + m_profile_lines.front());
+    add(ConsoleLevel::Normal, "camomile profile: report written to " + file.getFullPathName().toStdString());
+}
+
+void CamomileAudioProcessor::processNotifications()
+{
+    int const state = m_profile_state.load(std::memory_order_acquire);
+    if(state != 0)
+    {
+        writeProfilerReport(state);
+        m_profile_state.store(0, std::memory_order_release);
+    }
+    if(m_load_posted.exchange(false, std::memory_order_acquire))
+    {
+        postLoad();
+    }
+}
+
 void CamomileAudioProcessor::processInternal()
 {
+    CamomileRealtimeChecker::Scope const rtscope("processInternal");
+    auto const load_start = Time::getHighResolutionTicks();
     sendMessagesFromQueue();
+    m_jobs.processTick();
+    int const program = m_program_pending.exchange(-1);
+    if(program >= 0)
+    {
+        processProgram(program);
+    }
     sendPlayhead();
     sendMidiBuffer();
     processMessages();
+    processStateRequest();
     sendParameters();
+    auto const dsp_start = Time::getHighResolutionTicks();
+    m_voices.startTick();
     performDSP(m_audio_buffer_in.data(), m_audio_buffer_out.data());
+    m_voices.finishTick(m_audio_buffer_out.data());
+    m_pipeline.tick(m_audio_buffer_out.data());
+    m_load_dsp.add(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - dsp_start),
+                   static_cast<double>(Instance::getBlockSize()) / getSampleRate());
+    publishGuis();
+    if(m_profiling)
+    {
+        processProfiler();
+    }
     
     //////////////////////////////////////////////////////////////////////////////////////////
     //                                          MIDI OUT                                    //
@@ -292,14 +656,24 @@ void CamomileAudioProcessor::processInternal()
         m_midi_buffer_out.clear();
         processMidi();
     }
+    m_load_tick.add(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - load_start),
+                    static_cast<double>(Instance::getBlockSize()) / getSampleRate());
 }
 
 void CamomileAudioProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
+#if CAMOMILE_RT_CHECK
+    for(auto const& message : CamomileRealtimeChecker::flush())
+    {
+        add(ConsoleLevel::Error, message);
+    }
+#endif
+    CamomileRealtimeChecker::Scope const rtscope("processBlock");
     ScopedNoDenormals noDenormals;
+    auto const load_start = Time::getHighResolutionTicks();
     const int blocksize = Instance::getBlockSize();
     const int nsamples  = buffer.getNumSamples();
-    const int adv       = m_audio_advancement >= 64 ? 0 : m_audio_advancement;
+    const int adv       = m_audio_advancement >= blocksize ? 0 : m_audio_advancement;
     const int nleft     = blocksize - adv;
     const int nins      = getTotalNumInputChannels();
     const int nouts     = getTotalNumOutputChannels();
@@ -378,6 +752,7 @@ void CamomileAudioProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuffer&
             midiMessages.addEvents(m_midi_buffer_out, adv, nleft, -adv);
         }
         m_audio_advancement = 0;
+        processParameterChanges(nleft);
         processInternal();
         
         //////////////////////////////////////////////////////////////////////////////////////
@@ -405,6 +780,7 @@ void CamomileAudioProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuffer&
             {
                 midiMessages.addEvents(m_midi_buffer_out, 0, blocksize, pos);
             }
+            processParameterChanges(pos + blocksize);
             processInternal();
             pos += blocksize;
         }
@@ -438,6 +814,27 @@ void CamomileAudioProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuffer&
             m_audio_advancement = remaining;
         }
     }
+    
+    // the changes of the samples that are not processed yet are applied during the next block
+    for(auto& change : m_params_changes)
+    {
+        change.sample -= nsamples;
+    }
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    double const samplerate = getSampleRate();
+    if(samplerate > 0.)
+    {
+        m_load_block.add(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - load_start),
+                         static_cast<double>(nsamples) / samplerate);
+        m_load_samples += nsamples;
+        if(m_load_samples >= static_cast<int>(samplerate))
+        {
+            m_load_samples = 0;
+            publishLoad();
+        }
+    }
 }
 
 void CamomileAudioProcessor::processBlockBypassed (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
@@ -446,8 +843,10 @@ void CamomileAudioProcessor::processBlockBypassed (AudioBuffer<float>& buffer, M
     {
         sendMessagesFromQueue();
         sendPlayhead();
+        processParameterChanges(std::numeric_limits<int>::max());
         sendParameters();
         processMessages();
+        processStateRequest();
         const int nsamples  = buffer.getNumSamples();
         const int nins      = getTotalNumInputChannels();
         const int nouts     = getTotalNumOutputChannels();
@@ -499,36 +898,20 @@ AudioProcessorEditor* CamomileAudioProcessor::createEditor()
 
 void CamomileAudioProcessor::parseSaveInformation(const std::vector<pd::Atom>& list)
 {
-    if(m_temp_xml)
+    if(m_state_saving)
     {
-        XmlElement* patch = m_temp_xml->getChildByName("patch");
-        if(!patch)
+        // the pool only grows if the patch saves more lists or longer lists than before
+        if(m_state_nlists == m_state_lists.size())
         {
-            patch = m_temp_xml->createNewChildElement("patch");
-            if(!patch)
-            {
-                add(ConsoleLevel::Error, "can't allocate memory for saving plugin state.");
-                return;
-            }
+            m_state_lists.emplace_back();
         }
-        const int nchilds = patch->getNumChildElements();
-        XmlElement* preset = patch->createNewChildElement(String("list") + String(nchilds+1));
-        if(preset)
-        {
-            for(size_t i = 0; i < list.size(); ++i)
-            {
-                if(list[i].isFloat()) {
-                    preset->setAttribute(String("float") + String(i+1), list[i].getFloat()); }
-                else if(list[i].isSymbol())  {
-                    preset->setAttribute(String("string") + String(i+1), String(list[i].getSymbol())); }
-                else {
-                    preset->setAttribute(String("atom") + String(i+1), String("unknown")); }
-            }
-        }
-        else
+        auto& saved = m_state_lists[m_state_nlists++];
+        if(saved.atoms.size() < list.size())
         {
-            add(ConsoleLevel::Error, "can't allocate memory for saving plugin state.");
+            saved.atoms.resize(list.size());
         }
+        std::copy(list.begin(), list.end(), saved.atoms.begin());
+        saved.size = list.size();
     }
     else
     {
@@ -536,94 +919,227 @@ void CamomileAudioProcessor::parseSaveInformation(const std::vector<pd::Atom>& l
     }
 }
 
-void CamomileAudioProcessor::loadInformation(XmlElement const& xml)
+void CamomileAudioProcessor::saveArrays(CamomileState& state)
 {
-    bool loaded = false;
-    XmlElement const* patch = xml.getChildByName(juce::StringRef("patch"));
-    if(patch)
+    // The entries of the state are reused so the values don't have to be reallocated
+    // while the size of the arrays doesn't change.
+    auto const& names = CamomileEnvironment::getSavedArrays();
+    state.arrays.resize(names.size());
+    size_t count = 0;
+    for(auto const& name : names)
     {
-        const int nlists = patch->getNumChildElements();
-        std::vector<pd::Atom> vec;
-        for(int i = 0; i < nlists; ++i)
+        auto& array = state.arrays[count];
+        try
         {
-            XmlElement const* list = patch->getChildElement(i);
-            if(list)
-            {
-                const int natoms = list->getNumAttributes();
-                vec.resize(natoms);
-                
-                for(int j = 0; j < natoms; ++j)
-                {
-                    String const& name = list->getAttributeName(j);
-                    if(name.startsWith("float")) {
-                        vec[j] = static_cast<float>(list->getDoubleAttribute(name)); }
-                    else if(name.startsWith("string")){
-                        vec[j] = list->getStringAttribute(name).toStdString(); }
-                    else {
-                        vec[j] = "unknown"; }
-                }
-                
-                sendList("load", vec);
-                loaded = true;
-            }
+            getArray(name).read(array.values);
+            array.name = name;
+            ++count;
+        }
+        catch(std::exception const& e)
+        {
+            add(ConsoleLevel::Error, std::string("camomile savearray: ") + e.what());
         }
     }
-    
-    if(!loaded)
+    state.arrays.resize(count);
+}
+
+void CamomileAudioProcessor::loadArrays(CamomileState const& state)
+{
+    auto const& names = CamomileEnvironment::getSavedArrays();
+    for(auto const& array : state.arrays)
     {
-        sendBang("load");
+        if(std::find(names.begin(), names.end(), array.name) == names.end())
+        {
+            continue;
+        }
+        try
+        {
+            getArray(array.name).write(array.values);
+        }
+        catch(std::exception const& e)
+        {
+            add(ConsoleLevel::Error, std::string("camomile savearray: ") + e.what());
+        }
     }
 }
 
-void CamomileAudioProcessor::getStateInformation(MemoryBlock& destData)
+void CamomileAudioProcessor::mapSharedArrays()
 {
-    suspendProcessing(true);
-    XmlElement xml(String("CamomileSettings"));
-    m_temp_xml = &xml;
-    CamomileAudioParameter::saveStateInformation(xml, getParameters());
-    sendBang("save");
-    processMessages();
-    copyXmlToBinary(xml, destData);
-    m_temp_xml = nullptr;
-    XmlElement* cbounds = xml.createNewChildElement("console");
-    if(cbounds)
+    for(auto const& shared : CamomileEnvironment::getSharedArrays())
     {
-        cbounds->setAttribute(String("x"), m_console_bounds.getX());
-        cbounds->setAttribute(String("y"), m_console_bounds.getX());
-        cbounds->setAttribute(String("width"), m_console_bounds.getWidth());
-        cbounds->setAttribute(String("height"), m_console_bounds.getHeight());
+        try
+        {
+            auto table = CamomileSharedTable::get(shared.second);
+            void* vector = table->getData();
+            size_t size  = table->getSize();
+            getArray(shared.first).share(vector, size);
+            m_shared_arrays.push_back({shared.first, std::move(table), vector, size});
+        }
+        catch(std::string const& message)
+        {
+            add(ConsoleLevel::Error, "camomile sharedarray: " + message);
+        }
+        catch(std::exception const& e)
+        {
+            add(ConsoleLevel::Error, std::string("camomile sharedarray: ") + e.what());
+        }
     }
-    
-    suspendProcessing(false);
 }
 
-void CamomileAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+void CamomileAudioProcessor::unmapSharedArrays()
 {
-    suspendProcessing(true);
-    auto xml(getXmlFromBinary(data, sizeInBytes));
-    if(xml && xml->hasTagName("CamomileSettings"))
+    // the original vectors are restored so Pd frees its own memory when the patch is closed
+    for(auto& shared : m_shared_arrays)
     {
-        if(CamomileEnvironment::wantsAutoProgram())
+        try
         {
-            CamomileAudioParameter::loadStateInformation(*xml, getParameters());            
+            getArray(shared.name).unshare(shared.vector, shared.size);
         }
-        loadInformation(*xml);
-        XmlElement const* cbounds = xml->getChildByName(juce::StringRef("console"));
-        if(cbounds)
+        catch(std::exception const& e)
         {
-            m_console_bounds.setX(cbounds->getIntAttribute(String("x")));
-            m_console_bounds.setY(cbounds->getIntAttribute(String("y")));
-            m_console_bounds.setWidth(cbounds->getIntAttribute(String("width")));
-            m_console_bounds.setHeight(cbounds->getIntAttribute(String("height")));
+            add(ConsoleLevel::Error, std::string("camomile sharedarray: ") + e.what());
         }
     }
-    else
+    m_shared_arrays.clear();
+}
+
+void CamomileAudioProcessor::loadInformation(CamomileState const& state)
+{
+    // The arrays have already been restored by the thread that loads the state, so the patch
+    // can use them when it receives the lists.
+    for(auto const& list : state.lists)
+    {
+        sendList("load", list);
+    }
+    if(state.lists.empty())
     {
         sendBang("load");
     }
+}
+
+void CamomileAudioProcessor::processState()
+{
+    if(m_state_save)
+    {
+        m_state_nlists = 0;
+        m_state_saving = true;
+        sendBang("save");
+        processMessages();
+        m_state_saving = false;
+    }
+    else
+    {
+        loadInformation(m_state_buffer);
+    }
+}
+
+void CamomileAudioProcessor::processStateRequest()
+{
+    int expected = StatePending;
+    if(m_state_status.load(std::memory_order_relaxed) == StatePending &&
+       m_state_status.compare_exchange_strong(expected, StateBusy))
+    {
+        processState();
+        m_state_status = StateIdle;
+        m_state_done.signal();
+    }
+}
+
+void CamomileAudioProcessor::requestState(bool save)
+{
+    // The request is answered by the audio thread at the next tick so the processing
+    // isn't interrupted. If the processor doesn't run or doesn't answer in time (offline,
+    // suspended or stalled host), the request is cancelled and performed here.
+    m_state_save = save;
+    if(m_state_processing && !isSuspended() && getSampleRate() > 0.)
+    {
+        auto const blocksize = std::max(AudioProcessor::getBlockSize(), Instance::getBlockSize());
+        int const timeout = static_cast<int>(4000. * static_cast<double>(blocksize) / getSampleRate()) + 20;
+        m_state_done.reset();
+        m_state_status = StatePending;
+        if(m_state_done.wait(timeout))
+        {
+            return;
+        }
+        int expected = StatePending;
+        if(!m_state_status.compare_exchange_strong(expected, StateIdle))
+        {
+            m_state_done.wait(-1);
+            return;
+        }
+    }
+    suspendProcessing(true);
+    processState();
     suspendProcessing(false);
 }
 
+void CamomileAudioProcessor::getStateInformation(MemoryBlock& destData)
+{
+    std::lock_guard<std::mutex> guard(m_state_mutex);
+    m_state_buffer.lists.clear();
+    // the state of the processor never selects a program, only the generated presets do
+    m_state_buffer.program = -1;
+    CamomileAudioParameter::saveStateInformation(m_state_buffer.parameters, getParameters());
+    requestState(true);
+    for(size_t i = 0; i < m_state_nlists; ++i)
+    {
+        auto const& saved = m_state_lists[i];
+        m_state_buffer.lists.emplace_back(saved.atoms.begin(), saved.atoms.begin() + static_cast<std::ptrdiff_t>(saved.size));
+    }
+    // the arrays are read here because the values are allocated and the errors formatted
+    saveArrays(m_state_buffer);
+    m_state_buffer.console = m_console_bounds;
+    m_state_buffer.paths.clear();
+    if(m_path_abstract != nullptr)
+    {
+        m_state_buffer.makePathsAbstract([this](std::string const& path) { return m_path_abstract(m_path_handle, path); });
+    }
+    m_state_buffer.write(destData);
+}
+
+void CamomileAudioProcessor::readState(CamomileState& state, const void* data, int sizeInBytes)
+{
+    state.console = m_console_bounds;
+    if(state.read(data, sizeInBytes))
+    {
+        if(m_path_absolute != nullptr)
+        {
+            state.makePathsAbsolute([this](std::string const& path) { return m_path_absolute(m_path_handle, path); });
+        }
+        if(CamomileEnvironment::wantsAutoProgram())
+        {
+            CamomileAudioParameter::loadStateInformation(state.parameters, getParameters());
+        }
+        m_console_bounds = state.console;
+    }
+    else if(data != nullptr && sizeInBytes > 0)
+    {
+        add(ConsoleLevel::Error, "camomile: the state is invalid or has been saved by a newer version");
+    }
+}
+
+void CamomileAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    std::lock_guard<std::mutex> guard(m_state_mutex);
+    readState(m_state_buffer, data, sizeInBytes);
+    // a preset generated without the patch only selects a program
+    if(m_state_buffer.program >= 0)
+    {
+        setCurrentProgram(m_state_buffer.program);
+        m_state_buffer.program = -1;
+        return;
+    }
+    loadArrays(m_state_buffer);
+    requestState(false);
+}
+
+void CamomileAudioProcessor::setPathConverters(Converter abstract, Converter absolute, void* handle)
+{
+    m_path_abstract = abstract;
+    m_path_absolute = absolute;
+    m_path_handle   = handle;
+}
+
 void CamomileAudioProcessor::updateTrackProperties(const TrackProperties& properties)
 {
     m_track_properties = properties;
@@ -7,19 +7,30 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "PluginAutomation.h"
 #include "PluginConsole.h"
 #include "PluginFileWatcher.h"
+#include "PluginJobs.h"
+#include "PluginLoad.h"
+#include "PluginPipeline.h"
+#include "PluginState.h"
+#include "PluginStatePaths.h"
+#include "PluginTables.h"
+#include "PluginVoices.h"
+#include "PluginWorker.h"
 #include "Pd/PdInstance.hpp"
+#include <atomic>
+#include <mutex>
 
 // ======================================================================================== //
 //                                      PROCESSOR                                           //
 // ======================================================================================== //
 
-class CamomileAudioProcessor : public AudioProcessor, public pd::Instance, public CamomileConsole, public CamomileFileWatcher
+class CamomileAudioProcessor : public AudioProcessor, public pd::Instance, public CamomileConsole, public CamomileFileWatcher, public CamomileWorker, public CamomileStatePaths, public CamomileAutomation
 {
 public:
     CamomileAudioProcessor();
-    ~CamomileAudioProcessor() = default;
+    ~CamomileAudioProcessor();
     
     //////////////////////////////////////////////////////////////////////////////////////////
     //                                  AUDIO MANAGEMENT                                    //
@@ -30,6 +41,20 @@ public:
     void processBlock (AudioSampleBuffer&, MidiBuffer&) override;
     void processBlockBypassed (AudioBuffer<float>&, MidiBuffer&) override;
     AudioProcessorParameter* getBypassParameter() const override { return m_bypass_param; }
+    bool addParameterChange(int index, float value, int sample) override;
+    
+    //! @brief Gets the statistics of the time spent in the host blocks.
+    //! @details The statistics are published every second of audio.
+    CamomileLoadMeter::statistics getBlockLoad() const noexcept { return m_load_block.get(); }
+    
+    //! @brief Gets the statistics of the time spent in the Pd ticks.
+    //! @details The statistics are published every second of audio.
+    CamomileLoadMeter::statistics getTickLoad() const noexcept { return m_load_tick.get(); }
+    
+    //! @brief Gets the statistics of the time spent in the DSP of the Pd ticks.
+    //! @details The DSP of the instance, the voices and the pipeline is measured, the rest\n
+    //! of a tick is the overhead of Camomile (messages, MIDI, parameters).
+    CamomileLoadMeter::statistics getDSPLoad() const noexcept { return m_load_dsp.get(); }
     
     //////////////////////////////////////////////////////////////////////////////////////////
     //                              BUSES LAYOUTS MANAGEMENT                                //
@@ -37,6 +62,7 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 private:
     static BusesProperties getDefaultBusesProperties(const bool canonical);
+    static bool isBusesLayoutSupportedByEnvironment(const BusesLayout& layouts);
     void sendCurrentBusesLayoutInformation();
     void logBusesLayoutsInformation();
     bool canAddBus (bool isInput) const override;
@@ -61,6 +87,7 @@ public:
 
     void getStateInformation (MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
+    void setPathConverters(Converter abstract, Converter absolute, void* handle) override;
     
     //////////////////////////////////////////////////////////////////////////////////////////
     //                              PURE DATA RECEIVE METHODS                               //
@@ -76,6 +103,9 @@ public:
     void receiveMidiByte(const int port, const int byte) override;
     void receivePrint(const std::string& message) override;
     
+    //! @brief Processes the prints of the patch and of the voices.
+    void processPrints();
+    
     //////////////////////////////////////////////////////////////////////////////////////////
     
     void messageEnqueued() override;
@@ -88,6 +118,18 @@ public:
     void fileChanged() override;
     void reloadPatch();
     
+    //////////////////////////////////////////////////////////////////////////////////////////
+    //                                  HOST WORKER                                         //
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    void useHostWorker() override;
+    void scheduleWork(Scheduler scheduler, void* handle) override;
+    bool scheduleState(const void* data, int sizeInBytes, Scheduler scheduler, void* handle) override;
+    void performWork(uint32_t work) override;
+    void performWorkResponse(uint32_t work) override;
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
     Rectangle<int> getConsoleWindowBounds() const;
     void setConsoleWindowBounds(Rectangle<int> const& rect);
     
@@ -102,7 +144,12 @@ public:
     };
     
 private:
-    void loadInformation(XmlElement const& xml);
+    void loadInformation(CamomileState const& state);
+    void readState(CamomileState& state, const void* data, int sizeInBytes);
+    void saveArrays(CamomileState& state);
+    void loadArrays(CamomileState const& state);
+    void mapSharedArrays();
+    void unmapSharedArrays();
     
     void parseProgram(const std::vector<pd::Atom>& list);
     void parseSaveInformation(const std::vector<pd::Atom>& list);
@@ -111,10 +158,30 @@ private:
     void parseArray(const std::vector<pd::Atom>& list);
     void parseGui(const std::vector<pd::Atom>& list);
     void parseAudio(const std::vector<pd::Atom>& list);
+    void parseCpu(const std::vector<pd::Atom>& list);
+    void parseProfile(const std::vector<pd::Atom>& list);
+    void parseJob(const std::vector<pd::Atom>& list);
+    void parseSoundfile(const std::vector<pd::Atom>& list);
     
     
     void processInternal();
+    void publishLoad();
+    //! @brief Posts the statistics of the load in the console (on the message thread).
+    void postLoad();
+    void processProfiler();
+    void writeProfilerReport(int state);
+    void processNotifications();
+    void processProgram(int index);
+    //! @brief Computes the values of the parameters of each program.
+    //! @details Each program is sent to the patch once and the values of the parameters it\n
+    //! sets are captured. The values and the program of the patch are restored afterward.\n
+    //! The method must be called on the message thread while the processing is suspended.
+    void computeProgramSnapshots();
+    void processState();
+    void processStateRequest();
+    void requestState(bool save);
     void sendParameters();
+    void processParameterChanges(int end);
     void sendPlayhead();
     void sendMidiBuffer();
     
@@ -147,10 +214,111 @@ private:
     int m_program_current    = 0;
     std::vector<std::string> m_programs;
     std::vector<bool>        m_params_states;
+    std::vector<float>       m_params_sent;
+    //! @brief The flags of the parameters that changed since the last tick (a bit per parameter).
+    std::unique_ptr<std::atomic<uint64>[]> m_params_changed;
+    size_t                   m_params_words = 0;
+    //! @brief The changes of the parameters at a sample of the block, in the order of the samples.
+    struct param_change
+    {
+        int   sample;
+        int   index;
+        float value;
+    };
+    std::vector<param_change> m_params_changes;
+    //! @brief The normalized values of the parameters for each program, computed when the\n
+    //! patch is opened.
+    std::vector<std::vector<float>> m_program_snapshots;
+    std::atomic<int>         m_program_pending = {-1};
     QueueGui                 m_queue_gui = QueueGui(64);
     TrackProperties          m_track_properties;
-    XmlElement*              m_temp_xml;
+    bool                     m_state_saving = false;
+    
+    //! @brief The state request answered by the audio thread at the next tick.
+    enum StateStatus
+    {
+        StateIdle     = 0,
+        StatePending  = 1,
+        StateBusy     = 2
+    };
+    std::mutex               m_state_mutex;
+    std::atomic<int>         m_state_status = {StateIdle};
+    std::atomic<bool>        m_state_processing = {false};
+    bool                     m_state_save = true;
+    CamomileState            m_state_buffer;
+    //! @brief The lists saved by the patch when the state is saved by the audio thread.
+    //! @details The entries, the atoms and the symbols are reused from one save to another\n
+    //! so nothing is reallocated while the lists don't grow, the lists are copied in the\n
+    //! state buffer by the thread that requested the state.
+    struct saved_list
+    {
+        std::vector<pd::Atom> atoms;
+        size_t                size = 0;
+    };
+    std::vector<saved_list>  m_state_lists;
+    size_t                   m_state_nlists = 0;
+    WaitableEvent            m_state_done;
+    Converter                m_path_abstract = nullptr;
+    Converter                m_path_absolute = nullptr;
+    void*                    m_path_handle   = nullptr;
+    
+    //! @brief The work performed by the worker of the host.
+    std::atomic<bool>        m_work_host = {false};
+    std::atomic<uint32_t>    m_work_pending = {0};
+    std::atomic<bool>        m_work_restoring = {false};
+    CamomileState            m_work_state;
+    
+    //! @brief The time spent in the host blocks, in the Pd ticks and in their DSP.
+    CamomileLoadMeter        m_load_block;
+    CamomileLoadMeter        m_load_tick;
+    CamomileLoadMeter        m_load_dsp;
+    int                      m_load_samples = 0;
+    bool                     m_load_report  = false;
+    //! @brief Set by the audio thread when the statistics must be posted in the console.
+    std::atomic<bool>        m_load_posted  {false};
+    std::vector<pd::Atom>    m_atoms_load;
+    
+    //! @brief The arrays that use the tables shared by the instances with their own vectors.
+    struct shared_array
+    {
+        std::string                          name;
+        std::shared_ptr<CamomileSharedTable> table;
+        void*                                vector;
+        size_t                               size;
+    };
+    std::vector<shared_array> m_shared_arrays;
+    
+    //! @brief The voices performed in parallel with the patch.
+    CamomileVoices           m_voices {*this};
+    
+    //! @brief The second stage performed in series with the patch on another thread.
+    CamomilePipeline         m_pipeline {*this};
+    
+    //! @brief The profiler of the DSP chain started by the patch.
+    //! @details The audio thread only polls the profiler, the report is built and written\n
+    //! on the message thread. The state of the finished profiling is pending until then.
+    bool                     m_profiling = false;
+    std::atomic<int>         m_profile_state = {0};
+    std::string              m_profile_file;
+    std::vector<std::string> m_profile_lines;
     
     Rectangle<int>           m_console_bounds = Rectangle<int>(50, 50, 300, 370);
+    
+    //! @brief Calls the processor on the message thread when the audio thread has published\n
+    //! results that must be formatted or written (the file watcher already owns an updater).
+    class Notifier : public AsyncUpdater
+    {
+    public:
+        Notifier(CamomileAudioProcessor& owner) : m_owner(owner) {}
+        void handleAsyncUpdate() final { m_owner.processNotifications(); }
+    private:
+        CamomileAudioProcessor& m_owner;
+    };
+    Notifier                 m_notifier {*this};
+    
+    //! @brief The jobs requested by the patch (destroyed first because the threads use the\n
+    //! instance).
+    CamomileJobs             m_jobs {*this};
+    friend class CamomileAudioDescriptor;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CamomileAudioProcessor)
 };
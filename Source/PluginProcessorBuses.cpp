@@ -150,6 +150,11 @@ AudioProcessor::BusesProperties CamomileAudioProcessor::getDefaultBusesPropertie
 //////////////////////////////////////////////////////////////////////////////////////////////
 
 bool CamomileAudioProcessor::isBusesLayoutSupported(const BusesLayout& requestedLayout) const
+{
+    return isBusesLayoutSupportedByEnvironment(requestedLayout);
+}
+
+bool CamomileAudioProcessor::isBusesLayoutSupportedByEnvironment(const BusesLayout& requestedLayout)
 {
     const auto canoBus = CamomileBusesLayoutHelper::getCanonicalEquivalent(requestedLayout);
     const auto supportedBuses = CamomileBusesLayoutHelper::getSupportedBusesLayouts();
@@ -105,6 +105,13 @@ void CamomileAudioProcessor::receiveMidiByte(const int port, const int byte)
 //                                       PRINT METHOD                                       //
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+void CamomileAudioProcessor::processPrints()
+{
+    Instance::processPrints();
+    m_voices.processPrints();
+    m_pipeline.processPrints();
+}
+
 void CamomileAudioProcessor::receivePrint(const std::string& message)
 {
     if(!message.empty())
@@ -153,8 +160,11 @@ void CamomileAudioProcessor::receiveMessage(const std::string& msg, const std::v
                     CamomileAudioParameter* param = static_cast<CamomileAudioParameter *>(getParameters()[index]);
                     if(param)
                     {
-                        auto const newValue = list[2].getFloat();
-                        param->setValueNotifyingHost(param->convertTo0to1(newValue));
+                        auto const newValue = param->convertTo0to1(list[2].getFloat());
+                        if(param->getValue() != newValue)
+                        {
+                            param->setValueNotifyingHost(newValue);
+                        }
                         if(list.size() > 3) { add(ConsoleLevel::Error,
                                                   "camomile parameter set method extra arguments"); }
                     }
@@ -242,6 +252,22 @@ void CamomileAudioProcessor::receiveMessage(const std::string& msg, const std::v
     {
         parseAudio(list);
     }
+    else if(msg == "cpu")
+    {
+        parseCpu(list);
+    }
+    else if(msg == "profile")
+    {
+        parseProfile(list);
+    }
+    else if(msg == "job")
+    {
+        parseJob(list);
+    }
+    else if(msg == "soundfile")
+    {
+        parseSoundfile(list);
+    }
     else {  add(ConsoleLevel::Error, "camomile unknow message : " + msg); }
 }
 
@@ -257,6 +283,85 @@ void CamomileAudioProcessor::parseProgram(const std::vector<pd::Atom>& list)
     }
 }
 
+void CamomileAudioProcessor::parseCpu(const std::vector<pd::Atom>& list)
+{
+    if(list.size() >= 1 && list[0].isFloat())
+    {
+        m_load_report = list[0].getFloat() != 0.f;
+        if(list.size() > 1)
+        {
+            add(ConsoleLevel::Error, "camomile cpu method extra arguments");
+        }
+    }
+    else
+    {
+        add(ConsoleLevel::Error, "camomile cpu method accepts a float only");
+    }
+}
+
+void CamomileAudioProcessor::parseProfile(const std::vector<pd::Atom>& list)
+{
+    if(m_profile_state.load(std::memory_order_acquire) != 0)
+    {
+        add(ConsoleLevel::Error, "camomile profile method: the previous report isn't written yet");
+    }
+    else if(list.size() >= 1 && list[0].isFloat() && list[0].getFloat() >= 1.f)
+    {
+        m_profile_file = (list.size() >= 2 && list[1].isSymbol()) ? list[1].getSymbol() : std::string();
+        m_profiling = startProfiler(static_cast<int>(list[0].getFloat()));
+        if(!m_profiling)
+        {
+            add(ConsoleLevel::Error, "camomile profile method: the DSP is off");
+        }
+        if(list.size() > 2)
+        {
+            add(ConsoleLevel::Error, "camomile profile method extra arguments");
+        }
+    }
+    else
+    {
+        add(ConsoleLevel::Error, "camomile profile method needs a number of ticks");
+    }
+}
+
+void CamomileAudioProcessor::parseJob(const std::vector<pd::Atom>& list)
+{
+    if(list.size() >= 2 && list[0].isSymbol() && list[1].isSymbol())
+    {
+        if(!m_jobs.add(list[0].getSymbol(), list[1].getSymbol(), std::vector<pd::Atom>(list.begin()+2, list.end())))
+        {
+            add(ConsoleLevel::Error, "camomile job method: too many jobs pending");
+        }
+        else
+        {
+            m_work_pending.fetch_or(WorkJobs);
+        }
+    }
+    else
+    {
+        add(ConsoleLevel::Error, "camomile job method needs a receiver and a type");
+    }
+}
+
+void CamomileAudioProcessor::parseSoundfile(const std::vector<pd::Atom>& list)
+{
+    if(list.size() >= 3 && list[0].isSymbol() && list[1].isSymbol())
+    {
+        if(!m_jobs.add(list[0].getSymbol(), "soundfile", std::vector<pd::Atom>(list.begin()+1, list.end())))
+        {
+            add(ConsoleLevel::Error, "camomile soundfile method: too many jobs pending");
+        }
+        else
+        {
+            m_work_pending.fetch_or(WorkJobs);
+        }
+    }
+    else
+    {
+        add(ConsoleLevel::Error, "camomile soundfile method needs a receiver, a file and arrays");
+    }
+}
+
 void CamomileAudioProcessor::parseOpenPanel(const std::vector<pd::Atom>& list)
 {
     if(list.size() >= 1)
@@ -0,0 +1,286 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginRealtime.h"
+
+#if CAMOMILE_RT_CHECK
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#ifndef _WIN32
+#include <execinfo.h>
+#include <pthread.h>
+#endif
+
+// ======================================================================================== //
+//                                      REAL-TIME CHECKER                                   //
+// ======================================================================================== //
+
+namespace
+{
+    // The name of the real-time section of the thread and the flag that prevents the
+    // checker to report its own allocations and locks.
+    thread_local const char* rt_section   = nullptr;
+    thread_local bool        rt_reporting = false;
+
+    std::array<std::atomic<size_t>, 3>      rt_counters;
+    std::array<std::atomic<uint64_t>, 512>  rt_sites;
+    std::mutex                              rt_mutex;
+    std::vector<std::string>                rt_messages;
+    FILE*                                   rt_file = nullptr;
+
+    const char* const rt_names[] = {"allocation", "deallocation", "lock"};
+
+    //! @brief Registers a call site and returns false if it has already been reported.
+    bool registerSite(uint64_t hash) noexcept
+    {
+        hash = hash ? hash : 1;
+        for(size_t i = 0; i < rt_sites.size(); ++i)
+        {
+            auto& site = rt_sites[(hash + i) % rt_sites.size()];
+            uint64_t expected = 0;
+            if(site.compare_exchange_strong(expected, hash))
+            {
+                return true;
+            }
+            if(expected == hash)
+            {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    void openFile()
+    {
+        if(rt_file == nullptr)
+        {
+            const char* path = std::getenv("CAMOMILE_RT_LOG");
+#ifdef _WIN32
+            std::string const fallback = std::string(std::getenv("TEMP") ? std::getenv("TEMP") : ".") + "\\camomile-rt.log";
+#else
+            std::string const fallback = std::string(std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp") + "/camomile-rt.log";
+#endif
+            rt_file = std::fopen(path ? path : fallback.c_str(), "a");
+        }
+    }
+
+    void report(CamomileRealtimeChecker::Operation operation)
+    {
+        std::string message = std::string("camomile rt: ") + rt_names[operation] + " in " + rt_section;
+#ifndef _WIN32
+        void* frames[24];
+        int const nframes = backtrace(frames, 24);
+        uint64_t hash = static_cast<uint64_t>(operation) + 1469598103934665603ull;
+        for(int i = 0; i < nframes; ++i)
+        {
+            hash = (hash ^ reinterpret_cast<uint64_t>(frames[i])) * 1099511628211ull;
+        }
+        if(!registerSite(hash))
+        {
+            return;
+        }
+        // the first frames are the checker and the hook
+        if(char** symbols = backtrace_symbols(frames, nframes))
+        {
+            for(int i = 3; i < nframes; ++i)
+            {
+                message += std::string("\n    ") + symbols[i];
+            }
+            std::free(symbols);
+        }
+#else
+        if(!registerSite(reinterpret_cast<uint64_t>(rt_section) * 4 + static_cast<uint64_t>(operation)))
+        {
+            return;
+        }
+#endif
+        std::lock_guard<std::mutex> guard(rt_mutex);
+        openFile();
+        if(rt_file)
+        {
+            std::fprintf(rt_file, "%s\n", message.c_str());
+            std::fflush(rt_file);
+        }
+        rt_messages.push_back(std::move(message));
+    }
+}
+
+CamomileRealtimeChecker::Scope::Scope(const char* name) noexcept : m_previous(rt_section)
+{
+    rt_section = name;
+}
+
+CamomileRealtimeChecker::Scope::~Scope() noexcept
+{
+    rt_section = m_previous;
+}
+
+void CamomileRealtimeChecker::check(Operation operation) noexcept
+{
+    if(rt_section != nullptr && !rt_reporting)
+    {
+        rt_reporting = true;
+        ++rt_counters[static_cast<size_t>(operation)];
+        try
+        {
+            report(operation);
+        }
+        catch(...) {}
+        rt_reporting = false;
+    }
+}
+
+size_t CamomileRealtimeChecker::getNumOperations(Operation operation) noexcept
+{
+    return rt_counters[static_cast<size_t>(operation)].load();
+}
+
+std::vector<std::string> CamomileRealtimeChecker::flush()
+{
+    std::vector<std::string> messages;
+    std::lock_guard<std::mutex> guard(rt_mutex);
+    messages.swap(rt_messages);
+    return messages;
+}
+
+// ======================================================================================== //
+//                                          HOOKS                                           //
+// ======================================================================================== //
+
+#if CAMOMILE_RT_WRAP
+
+// The symbols are wrapped by the linker (--wrap). The option only rewrites the references
+// of the objects that are linked, the allocations performed inside the shared standard
+// library aren't caught so the operators new and delete are also replaced below.
+extern "C"
+{
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t count, size_t size);
+    void* __real_realloc(void* ptr, size_t size);
+    void  __real_free(void* ptr);
+    int   __real_pthread_mutex_lock(pthread_mutex_t* mutex);
+
+    void* __wrap_malloc(size_t size)
+    {
+        CamomileRealtimeChecker::check(CamomileRealtimeChecker::Allocation);
+        return __real_malloc(size);
+    }
+
+    void* __wrap_calloc(size_t count, size_t size)
+    {
+        CamomileRealtimeChecker::check(CamomileRealtimeChecker::Allocation);
+        return __real_calloc(count, size);
+    }
+
+    void* __wrap_realloc(void* ptr, size_t size)
+    {
+        CamomileRealtimeChecker::check(CamomileRealtimeChecker::Allocation);
+        return __real_realloc(ptr, size);
+    }
+
+    void __wrap_free(void* ptr)
+    {
+        if(ptr)
+        {
+            CamomileRealtimeChecker::check(CamomileRealtimeChecker::Deallocation);
+        }
+        __real_free(ptr);
+    }
+
+    int __wrap_pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        CamomileRealtimeChecker::check(CamomileRealtimeChecker::Lock);
+        return __real_pthread_mutex_lock(mutex);
+    }
+}
+
+// The operators use the real functions so the allocations aren't reported twice
+#define CAMOMILE_RT_MALLOC __real_malloc
+#define CAMOMILE_RT_FREE __real_free
+
+#else
+
+#define CAMOMILE_RT_MALLOC std::malloc
+#define CAMOMILE_RT_FREE std::free
+
+#endif
+
+void* operator new(std::size_t size)
+{
+    CamomileRealtimeChecker::check(CamomileRealtimeChecker::Allocation);
+    if(void* ptr = CAMOMILE_RT_MALLOC(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    CamomileRealtimeChecker::check(CamomileRealtimeChecker::Allocation);
+    return CAMOMILE_RT_MALLOC(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if(ptr)
+    {
+        CamomileRealtimeChecker::check(CamomileRealtimeChecker::Deallocation);
+    }
+    CAMOMILE_RT_FREE(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::nothrow_t const&) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::nothrow_t const&) noexcept
+{
+    operator delete(ptr);
+}
+
+#else
+
+void CamomileRealtimeChecker::check(Operation) noexcept {}
+
+size_t CamomileRealtimeChecker::getNumOperations(Operation) noexcept { return 0; }
+
+std::vector<std::string> CamomileRealtimeChecker::flush() { return std::vector<std::string>(); }
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// ======================================================================================== //
+//                                      REAL-TIME CHECKER                                   //
+// ======================================================================================== //
+
+//! @brief Reports the allocations and the locks performed in the real-time sections.
+//! @details The checker is only enabled with the debug build option CAMOMILE_RT_CHECK.\n
+//! The operators new and delete are replaced on all the platforms. On Linux, malloc,\n
+//! calloc, realloc, free and pthread_mutex_lock are also wrapped by the linker so the\n
+//! allocations and the locks of libpd are caught. Each call site is reported\n
+//! once with its backtrace in the log file (CAMOMILE_RT_LOG or camomile-rt.log in the\n
+//! temporary directory) and in the messages returned by flush().
+class CamomileRealtimeChecker
+{
+public:
+    
+    //! @brief Marks the current thread as real-time during the lifetime of the scope.
+    class Scope
+    {
+    public:
+#if CAMOMILE_RT_CHECK
+        Scope(const char* name) noexcept;
+        ~Scope() noexcept;
+    private:
+        const char* m_previous;
+#else
+        Scope(const char*) noexcept {}
+#endif
+    };
+    
+    //! @brief The kind of operation that is not real-time safe.
+    enum Operation
+    {
+        Allocation      = 0,
+        Deallocation    = 1,
+        Lock            = 2
+    };
+    
+    //! @brief Reports an operation if the current thread is in a real-time section.
+    static void check(Operation operation) noexcept;
+    
+    //! @brief Gets the number of operations caught since the beginning.
+    static size_t getNumOperations(Operation operation) noexcept;
+    
+    //! @brief Gets and clears the messages of the call sites caught since the last call.
+    static std::vector<std::string> flush();
+};
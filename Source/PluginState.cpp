@@ -0,0 +1,392 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginState.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// ======================================================================================== //
+//                                          FORMAT                                          //
+// ======================================================================================== //
+
+//  header  : 'CMST' | int32 version | int32 flags | payload
+//  payload : sequence of blocks, gzipped if the flag compressed is set
+//  block   : 4 char tag | int32 size | data
+//  PARM    : int32 count | count x float32
+//  LIST    : int32 count | count x atom (int8 type | float32 or int32 size + utf8)
+//  ARRY    : int32 size + utf8 name | int32 count | count x float32
+//  CONS    : 4 x int32 (x, y, width, height)
+//  PATH    : int32 count | count x (int32 list index, int32 atom index)
+//  PROG    : int32 program index
+//  All the integers and floats are little endian.
+
+static const char state_magic[] = {'C', 'M', 'S', 'T'};
+static const int  state_flag_compressed = 1;
+static const char atom_float  = 'f';
+static const char atom_symbol = 's';
+
+// The values of the arrays are copied in bulk on little endian hosts
+static void writeFloats(MemoryOutputStream& stream, std::vector<float> const& values)
+{
+#if JUCE_LITTLE_ENDIAN
+    stream.write(values.data(), values.size() * sizeof(float));
+#else
+    for(auto const value : values)
+    {
+        stream.writeFloat(value);
+    }
+#endif
+}
+
+static void readFloats(MemoryInputStream& stream, std::vector<float>& values)
+{
+#if JUCE_LITTLE_ENDIAN
+    stream.read(values.data(), static_cast<int>(values.size() * sizeof(float)));
+#else
+    for(auto& value : values)
+    {
+        value = stream.readFloat();
+    }
+#endif
+}
+
+static void writeBlock(MemoryOutputStream& stream, const char* tag, MemoryOutputStream const& block)
+{
+    stream.write(tag, 4);
+    stream.writeInt(static_cast<int>(block.getDataSize()));
+    stream.write(block.getData(), block.getDataSize());
+}
+
+void CamomileState::write(MemoryBlock& destData) const
+{
+    MemoryOutputStream payload;
+    {
+        MemoryOutputStream block;
+        block.writeInt(static_cast<int>(parameters.size()));
+        for(auto const value : parameters)
+        {
+            block.writeFloat(value);
+        }
+        writeBlock(payload, "PARM", block);
+    }
+    for(auto const& list : lists)
+    {
+        MemoryOutputStream block;
+        block.writeInt(static_cast<int>(list.size()));
+        for(auto const& atom : list)
+        {
+            if(atom.isFloat())
+            {
+                block.writeByte(atom_float);
+                block.writeFloat(atom.getFloat());
+            }
+            else
+            {
+                block.writeByte(atom_symbol);
+                block.writeInt(static_cast<int>(atom.getSymbol().size()));
+                block.write(atom.getSymbol().data(), atom.getSymbol().size());
+            }
+        }
+        writeBlock(payload, "LIST", block);
+    }
+    for(auto const& array : arrays)
+    {
+        MemoryOutputStream block(array.name.size() + array.values.size() * sizeof(float) + 8);
+        block.writeInt(static_cast<int>(array.name.size()));
+        block.write(array.name.data(), array.name.size());
+        block.writeInt(static_cast<int>(array.values.size()));
+        writeFloats(block, array.values);
+        writeBlock(payload, "ARRY", block);
+    }
+    {
+        MemoryOutputStream block;
+        block.writeInt(console.getX());
+        block.writeInt(console.getY());
+        block.writeInt(console.getWidth());
+        block.writeInt(console.getHeight());
+        writeBlock(payload, "CONS", block);
+    }
+    if(!paths.empty())
+    {
+        MemoryOutputStream block;
+        block.writeInt(static_cast<int>(paths.size()));
+        for(auto const& path : paths)
+        {
+            block.writeInt(path.list);
+            block.writeInt(path.atom);
+        }
+        writeBlock(payload, "PATH", block);
+    }
+    if(program >= 0)
+    {
+        MemoryOutputStream block;
+        block.writeInt(program);
+        writeBlock(payload, "PROG", block);
+    }
+
+    bool const compressed = payload.getDataSize() > compression_threshold;
+    MemoryOutputStream stream(destData, false);
+    stream.write(state_magic, 4);
+    stream.writeInt(version);
+    stream.writeInt(compressed ? state_flag_compressed : 0);
+    if(compressed)
+    {
+        GZIPCompressorOutputStream zip(stream, 1);
+        zip.write(payload.getData(), payload.getDataSize());
+        zip.flush();
+    }
+    else
+    {
+        stream.write(payload.getData(), payload.getDataSize());
+    }
+    stream.flush();
+}
+
+bool CamomileState::read(const void* data, int sizeInBytes)
+{
+    parameters.clear();
+    lists.clear();
+    arrays.clear();
+    paths.clear();
+    program = -1;
+    if(data == nullptr || sizeInBytes < 12)
+    {
+        return false;
+    }
+    if(std::memcmp(data, state_magic, 4) == 0)
+    {
+        return readBinary(data, static_cast<size_t>(sizeInBytes));
+    }
+    auto xml(AudioProcessor::getXmlFromBinary(data, sizeInBytes));
+    return xml != nullptr && readXml(*xml);
+}
+
+bool CamomileState::readBinary(const void* data, size_t size)
+{
+    MemoryInputStream header(data, size, false);
+    header.skipNextBytes(4);
+    // the new blocks are skipped by the older readers, the version only changes when the
+    // layout of the existing blocks changes so a newer version can't be read
+    int const format = header.readInt();
+    if(format < 1 || format > version)
+    {
+        return false;
+    }
+    int const flags = header.readInt();
+    MemoryBlock payload;
+    if(flags & state_flag_compressed)
+    {
+        MemoryInputStream compressed(static_cast<const char*>(data) + 12, size - 12, false);
+        GZIPDecompressorInputStream unzip(compressed);
+        unzip.readIntoMemoryBlock(payload);
+    }
+    else
+    {
+        payload.append(static_cast<const char*>(data) + 12, size - 12);
+    }
+
+    MemoryInputStream stream(payload, false);
+    while(stream.getNumBytesRemaining() >= 8)
+    {
+        char tag[4];
+        stream.read(tag, 4);
+        int const length = stream.readInt();
+        if(length < 0 || static_cast<int64>(length) > stream.getNumBytesRemaining())
+        {
+            return false;
+        }
+        MemoryInputStream block(static_cast<const char*>(payload.getData()) + stream.getPosition(),
+                                static_cast<size_t>(length), false);
+        stream.skipNextBytes(length);
+
+        if(std::memcmp(tag, "PARM", 4) == 0)
+        {
+            int const count = block.readInt();
+            if(count < 0 || static_cast<int64>(count) * 4 > block.getNumBytesRemaining())
+            {
+                return false;
+            }
+            parameters.resize(static_cast<size_t>(count));
+            for(auto& value : parameters)
+            {
+                value = block.readFloat();
+            }
+        }
+        else if(std::memcmp(tag, "LIST", 4) == 0)
+        {
+            int const count = block.readInt();
+            if(count < 0 || count > block.getNumBytesRemaining())
+            {
+                return false;
+            }
+            std::vector<pd::Atom> list;
+            list.reserve(static_cast<size_t>(count));
+            for(int i = 0; i < count; ++i)
+            {
+                char const type = block.readByte();
+                if(type == atom_float)
+                {
+                    list.push_back(block.readFloat());
+                }
+                else if(type == atom_symbol)
+                {
+                    int const ssize = block.readInt();
+                    if(ssize < 0 || ssize > block.getNumBytesRemaining())
+                    {
+                        return false;
+                    }
+                    std::string symbol(static_cast<size_t>(ssize), '\0');
+                    block.read(&symbol[0], ssize);
+                    list.push_back(symbol);
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            lists.push_back(std::move(list));
+        }
+        else if(std::memcmp(tag, "ARRY", 4) == 0)
+        {
+            int const nsize = block.readInt();
+            if(nsize < 0 || nsize > block.getNumBytesRemaining())
+            {
+                return false;
+            }
+            array_values array;
+            array.name.resize(static_cast<size_t>(nsize));
+            block.read(&array.name[0], nsize);
+            int const count = block.readInt();
+            if(count < 0 || static_cast<int64>(count) * 4 > block.getNumBytesRemaining())
+            {
+                return false;
+            }
+            array.values.resize(static_cast<size_t>(count));
+            readFloats(block, array.values);
+            arrays.push_back(std::move(array));
+        }
+        else if(std::memcmp(tag, "CONS", 4) == 0)
+        {
+            int const x = block.readInt();
+            int const y = block.readInt();
+            int const w = block.readInt();
+            int const h = block.readInt();
+            console = Rectangle<int>(x, y, w, h);
+        }
+        else if(std::memcmp(tag, "PATH", 4) == 0)
+        {
+            int const count = block.readInt();
+            if(count < 0 || static_cast<int64>(count) * 8 > block.getNumBytesRemaining())
+            {
+                return false;
+            }
+            paths.resize(static_cast<size_t>(count));
+            for(auto& path : paths)
+            {
+                path.list = block.readInt();
+                path.atom = block.readInt();
+            }
+        }
+        else if(std::memcmp(tag, "PROG", 4) == 0)
+        {
+            program = block.readInt();
+        }
+    }
+    return true;
+}
+
+void CamomileState::makePathsAbstract(std::function<std::string(std::string const&)> const& convert)
+{
+    paths.clear();
+    for(size_t i = 0; i < lists.size(); ++i)
+    {
+        for(size_t j = 0; j < lists[i].size(); ++j)
+        {
+            auto& atom = lists[i][j];
+            if(atom.isSymbol() && File::isAbsolutePath(atom.getSymbol()) && File(atom.getSymbol()).exists())
+            {
+                atom = convert(atom.getSymbol());
+                paths.push_back({static_cast<int>(i), static_cast<int>(j)});
+            }
+        }
+    }
+}
+
+void CamomileState::makePathsAbsolute(std::function<std::string(std::string const&)> const& convert)
+{
+    for(auto const& path : paths)
+    {
+        if(path.list >= 0 && static_cast<size_t>(path.list) < lists.size() &&
+           path.atom >= 0 && static_cast<size_t>(path.atom) < lists[static_cast<size_t>(path.list)].size())
+        {
+            auto& atom = lists[static_cast<size_t>(path.list)][static_cast<size_t>(path.atom)];
+            if(atom.isSymbol())
+            {
+                atom = convert(atom.getSymbol());
+            }
+        }
+    }
+    paths.clear();
+}
+
+bool CamomileState::readXml(XmlElement const& xml)
+{
+    if(!xml.hasTagName("CamomileSettings"))
+    {
+        return false;
+    }
+    XmlElement const* params = xml.getChildByName(juce::StringRef("params"));
+    if(params)
+    {
+        for(int i = 0; i < params->getNumAttributes(); ++i)
+        {
+            String const& name = params->getAttributeName(i);
+            int const index = name.startsWith("param") ? name.substring(5).getIntValue() : 0;
+            if(index > 0)
+            {
+                if(parameters.size() < static_cast<size_t>(index))
+                {
+                    parameters.resize(static_cast<size_t>(index), std::numeric_limits<float>::quiet_NaN());
+                }
+                parameters[static_cast<size_t>(index-1)] = static_cast<float>(params->getDoubleAttribute(name));
+            }
+        }
+    }
+    XmlElement const* patch = xml.getChildByName(juce::StringRef("patch"));
+    if(patch)
+    {
+        for(int i = 0; i < patch->getNumChildElements(); ++i)
+        {
+            XmlElement const* list = patch->getChildElement(i);
+            if(list)
+            {
+                const int natoms = list->getNumAttributes();
+                std::vector<pd::Atom> vec(static_cast<size_t>(natoms));
+                for(int j = 0; j < natoms; ++j)
+                {
+                    String const& name = list->getAttributeName(j);
+                    if(name.startsWith("float")) {
+                        vec[j] = static_cast<float>(list->getDoubleAttribute(name)); }
+                    else if(name.startsWith("string")){
+                        vec[j] = list->getStringAttribute(name).toStdString(); }
+                    else {
+                        vec[j] = "unknown"; }
+                }
+                lists.push_back(std::move(vec));
+            }
+        }
+    }
+    XmlElement const* cbounds = xml.getChildByName(juce::StringRef("console"));
+    if(cbounds)
+    {
+        console.setX(cbounds->getIntAttribute(String("x")));
+        console.setY(cbounds->getIntAttribute(String("y")));
+        console.setWidth(cbounds->getIntAttribute(String("width")));
+        console.setHeight(cbounds->getIntAttribute(String("height")));
+    }
+    return true;
+}
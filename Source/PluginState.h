@@ -0,0 +1,88 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Pd/PdAtom.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+// ======================================================================================== //
+//                                          STATE                                           //
+// ======================================================================================== //
+
+//! @brief The state of the plugin saved by the host.
+//! @details The state is written in a versioned binary chunk: a header (magic, version,\n
+//! flags) followed by a sequence of tagged and length-prefixed blocks. The payload is\n
+//! compressed when it is large (the lists saved by the patch can contain big tables).\n
+//! Unknown blocks are skipped so older versions can read newer states that only add\n
+//! blocks, the version is incremented when the layout of the existing blocks changes and\n
+//! the states of a newer version are rejected. The XML format of the previous versions\n
+//! can still be read but is never written.
+class CamomileState
+{
+public:
+
+    //! @brief The values of the parameters, a NaN value means that the value is undefined.
+    std::vector<float> parameters;
+
+    //! @brief The lists saved by the patch.
+    std::vector<std::vector<pd::Atom>> lists;
+
+    //! @brief The values of an array saved with the option savearray.
+    struct array_values
+    {
+        std::string         name;
+        std::vector<float>  values;
+    };
+    
+    //! @brief The arrays saved within the state.
+    std::vector<array_values> arrays;
+
+    //! @brief The bounds of the console window.
+    Rectangle<int> console = Rectangle<int>(50, 50, 300, 370);
+    
+    //! @brief The program selected by the state, -1 if the state doesn't select a program.
+    //! @details The presets generated without the patch only select a program.
+    int program = -1;
+    
+    //! @brief The position of a symbol of the lists that is the path of a file.
+    struct path_position
+    {
+        int list;
+        int atom;
+    };
+    
+    //! @brief The symbols of the lists that are paths of files converted by the host.
+    std::vector<path_position> paths;
+    
+    //! @brief Converts the symbols of the lists that are absolute paths of existing files.
+    //! @details The function converts a path into a path portable with the state (LV2\n
+    //! map-path) and the positions of the symbols are saved with the state.
+    void makePathsAbstract(std::function<std::string(std::string const&)> const& convert);
+    
+    //! @brief Converts back the symbols saved as paths of files into absolute paths.
+    void makePathsAbsolute(std::function<std::string(std::string const&)> const& convert);
+
+    //! @brief Writes the state in the binary format.
+    void write(MemoryBlock& destData) const;
+
+    //! @brief Reads the state from the binary format or from the legacy XML format.
+    //! @details Returns false if the data is not a valid state.
+    bool read(const void* data, int sizeInBytes);
+
+private:
+    bool readBinary(const void* data, size_t size);
+    bool readXml(XmlElement const& xml);
+
+    //! @brief The version of the binary format, the highest version that can be read.
+    static const int version = 1;
+
+    //! @brief The size above which the payload is compressed.
+    static const size_t compression_threshold = 64 * 1024;
+};
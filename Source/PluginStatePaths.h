@@ -0,0 +1,28 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <string>
+
+// ======================================================================================== //
+//                                      STATE PATHS                                         //
+// ======================================================================================== //
+
+//! @brief The interface of a processor whose states can reference files.
+//! @details The wrapper of a plugin format (LV2 map-path) sets the converters of the host\n
+//! during the save or the restoration of a state and resets them afterward.
+class CamomileStatePaths
+{
+public:
+    //! @brief The function that converts a path.
+    typedef std::string (*Converter)(void* handle, std::string const& path);
+    
+    virtual ~CamomileStatePaths() = default;
+    
+    //! @brief Sets the converters of the paths, nullptr to reset.
+    virtual void setPathConverters(Converter abstract, Converter absolute, void* handle) = 0;
+};
@@ -0,0 +1,172 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginTables.h"
+#include "Pd/PdArray.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// ======================================================================================== //
+//                                      SHARED TABLE                                        //
+// ======================================================================================== //
+
+std::shared_ptr<CamomileSharedTable> CamomileSharedTable::get(std::string const& path)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<CamomileSharedTable>> tables;
+    std::lock_guard<std::mutex> guard(mutex);
+    auto table = tables[path].lock();
+    if(table)
+    {
+        return table;
+    }
+
+    File const file(path);
+    if(!file.existsAsFile())
+    {
+        throw std::string("can't find the file ") + path;
+    }
+    size_t const size = static_cast<size_t>(file.getSize()) / sizeof(float);
+    if(size == 0)
+    {
+        throw std::string("the file ") + path + " is empty";
+    }
+    size_t const wordsize = pd::Array::getWordSize();
+    File const words = wordsize == sizeof(float) ? file : getWordsFile(file, size, wordsize);
+    table.reset(new CamomileSharedTable(words, size * wordsize));
+    if(table->m_data == nullptr)
+    {
+        throw std::string("can't map the file ") + words.getFullPathName().toStdString();
+    }
+    table->m_size = size;
+    tables[path] = table;
+    return table;
+}
+
+File CamomileSharedTable::getWordsFile(File const& file, size_t size, size_t wordsize)
+{
+    // The cache file is identified by the path, the size and the date of the file.
+    String const prefix = String::toHexString(file.getFullPathName().hashCode64()) + "-";
+    String const name = prefix + String(static_cast<int64>(size))
+    + "-" + String(file.getLastModificationTime().toMilliseconds())
+    + "-" + String(static_cast<int>(wordsize)) + ".words";
+    File const cache = File::getSpecialLocation(File::tempDirectory).getChildFile("Camomile").getChildFile(name);
+    if(cache.existsAsFile() && static_cast<size_t>(cache.getSize()) == size * wordsize)
+    {
+        return cache;
+    }
+    if(!cache.getParentDirectory().createDirectory())
+    {
+        throw std::string("can't create the directory ") + cache.getParentDirectory().getFullPathName().toStdString();
+    }
+
+    // The file is written aside and moved so another process never maps a partial file.
+    TemporaryFile temporary(cache);
+    {
+        FileInputStream input(file);
+        FileOutputStream output(temporary.getFile());
+        if(!input.openedOk() || !output.openedOk())
+        {
+            throw std::string("can't convert the file ") + file.getFullPathName().toStdString();
+        }
+        size_t const chunk = 65536;
+        std::vector<uint32> values(chunk);
+        std::vector<char> words(chunk * wordsize, 0);
+        for(size_t position = 0; position < size; position += chunk)
+        {
+            size_t const count = std::min(chunk, size - position);
+            if(input.read(values.data(), static_cast<int>(count * sizeof(float))) != static_cast<int>(count * sizeof(float)))
+            {
+                throw std::string("can't read the file ") + file.getFullPathName().toStdString();
+            }
+            for(size_t i = 0; i < count; ++i)
+            {
+                uint32 const value = ByteOrder::swapIfBigEndian(values[i]);
+                std::memcpy(words.data() + i * wordsize, &value, sizeof(float));
+            }
+            if(!output.write(words.data(), count * wordsize))
+            {
+                throw std::string("can't write the file ") + temporary.getFile().getFullPathName().toStdString();
+            }
+        }
+    }
+    if(!temporary.overwriteTargetFileWithTemporary() && !cache.existsAsFile())
+    {
+        throw std::string("can't write the file ") + cache.getFullPathName().toStdString();
+    }
+
+    // The caches of the previous versions of the file are removed. A cache still mapped by
+    // another process stays readable until it's unmapped (or isn't deleted on Windows).
+    for(auto const& old : cache.getParentDirectory().findChildFiles(File::findFiles, false, prefix + "*.words"))
+    {
+        if(old != cache)
+        {
+            old.deleteFile();
+        }
+    }
+    return cache;
+}
+
+CamomileSharedTable::CamomileSharedTable(File const& file, size_t bytes) : m_bytes(bytes)
+{
+#if JUCE_WINDOWS
+    m_handle = CreateFileW(file.getFullPathName().toWideCharPointer(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(m_handle != INVALID_HANDLE_VALUE)
+    {
+        m_mapping = CreateFileMappingW(m_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(m_mapping != nullptr)
+        {
+            m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, bytes);
+        }
+    }
+    else
+    {
+        m_handle = nullptr;
+    }
+#else
+    int const fd = open(file.getFullPathName().toRawUTF8(), O_RDONLY);
+    if(fd != -1)
+    {
+        void* data = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        m_data = data != MAP_FAILED ? data : nullptr;
+        close(fd);
+    }
+#endif
+}
+
+CamomileSharedTable::~CamomileSharedTable()
+{
+#if JUCE_WINDOWS
+    if(m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if(m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if(m_handle != nullptr)
+    {
+        CloseHandle(m_handle);
+    }
+#else
+    if(m_data != nullptr)
+    {
+        munmap(m_data, m_bytes);
+    }
+#endif
+}
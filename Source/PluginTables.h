@@ -0,0 +1,57 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <string>
+
+// ======================================================================================== //
+//                                      SHARED TABLE                                        //
+// ======================================================================================== //
+
+//! @brief A sample file mapped in memory and shared by all the instances of the process.
+//! @details The file contains raw 32-bit little-endian floats. The values of a Pd array are\n
+//! larger than a float on 64-bit systems, so the file is converted once into a cache file\n
+//! in the temporary directory with the layout of the arrays and the cache file is mapped.\n
+//! The conversion writes twice the size of the file synchronously when the first instance\n
+//! maps a new or modified file (while the patch is loaded), the next instances and the next\n
+//! sessions reuse the cache and the caches of the previous versions of the file are removed.\n
+//! The mapping is read-only so the pages are shared by all the instances. The vector of a\n
+//! table is recorded by Pd as shared so the "resize" message, the swaps of the jobs and the\n
+//! writes of Camomile (savearray, editor) are refused. The objects that write or resize an\n
+//! array directly (tabwrite~, [array set], [array size], soundfiler) must not be used on\n
+//! these arrays: a write crashes the process.
+class CamomileSharedTable
+{
+public:
+    ~CamomileSharedTable();
+
+    //! @brief Gets the table of a file and maps the file if no instance uses it.
+    //! @details Throws a string if the file can't be mapped.
+    static std::shared_ptr<CamomileSharedTable> get(std::string const& path);
+
+    //! @brief Gets the values with the layout of the vector of an array.
+    void* getData() const noexcept { return m_data; }
+
+    //! @brief Gets the number of values.
+    size_t getSize() const noexcept { return m_size; }
+
+private:
+    CamomileSharedTable(File const& file, size_t size);
+    static File getWordsFile(File const& file, size_t size, size_t wordsize);
+
+    void*   m_data  = nullptr;
+    size_t  m_bytes = 0;
+    size_t  m_size  = 0;
+#if JUCE_WINDOWS
+    void*   m_handle  = nullptr;
+    void*   m_mapping = nullptr;
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CamomileSharedTable)
+};
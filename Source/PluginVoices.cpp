@@ -0,0 +1,351 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "PluginVoices.h"
+#include <algorithm>
+#include <thread>
+
+// ======================================================================================== //
+//                                          VOICE                                           //
+// ======================================================================================== //
+
+class CamomileVoices::Voice : public pd::Instance
+{
+public:
+    Voice(pd::Instance& owner) : pd::Instance("camomile"), m_owner(owner) {}
+
+    void receivePrint(const std::string& message) override
+    {
+        m_owner.receivePrint(message);
+    }
+    
+    // The messages and the MIDI events are dequeued by the audio thread once all the voices
+    // have been performed, so the owner receives them as if they came from the main patch.
+    void receiveMessage(const std::string& msg, const std::vector<pd::Atom>& list) override
+    {
+        m_owner.receiveMessage(msg, list);
+    }
+    
+    void receiveNoteOn(const int channel, const int pitch, const int velocity) override
+    {
+        m_owner.receiveNoteOn(channel, pitch, velocity);
+    }
+    
+    void receiveControlChange(const int channel, const int controller, const int value) override
+    {
+        m_owner.receiveControlChange(channel, controller, value);
+    }
+    
+    void receiveProgramChange(const int channel, const int value) override
+    {
+        m_owner.receiveProgramChange(channel, value);
+    }
+    
+    void receivePitchBend(const int channel, const int value) override
+    {
+        m_owner.receivePitchBend(channel, value);
+    }
+    
+    void receiveAftertouch(const int channel, const int value) override
+    {
+        m_owner.receiveAftertouch(channel, value);
+    }
+    
+    void receivePolyAftertouch(const int channel, const int pitch, const int value) override
+    {
+        m_owner.receivePolyAftertouch(channel, pitch, value);
+    }
+    
+    void receiveMidiByte(const int port, const int byte) override
+    {
+        m_owner.receiveMidiByte(port, byte);
+    }
+
+    std::vector<float>  outputs;
+    int                 channel = 0;
+    int                 pitch   = -1;
+    bool                active  = false;
+    uint64_t            stamp   = 0;
+private:
+    pd::Instance&       m_owner;
+};
+
+// ======================================================================================== //
+//                                          WORKER                                          //
+// ======================================================================================== //
+
+class CamomileVoices::Worker : public Thread
+{
+public:
+    Worker(CamomileVoices& owner) : Thread("camomile voices"), m_owner(owner) {}
+    
+    void run() override
+    {
+        m_owner.run();
+    }
+private:
+    CamomileVoices& m_owner;
+};
+
+// ======================================================================================== //
+//                                          VOICES                                          //
+// ======================================================================================== //
+
+CamomileVoices::CamomileVoices(pd::Instance& owner) : m_owner(owner)
+{
+
+}
+
+CamomileVoices::~CamomileVoices()
+{
+    close();
+}
+
+void CamomileVoices::open(std::string const& path, std::string const& name, size_t nvoices)
+{
+    close();
+    for(size_t i = 0; i < nvoices; ++i)
+    {
+        m_voices.push_back(std::make_unique<Voice>(m_owner));
+        m_voices.back()->openPatch(path, name);
+        m_voices.back()->sendFloat("voice", static_cast<float>(i+1));
+        m_voices.back()->processMessages();
+    }
+
+    // The audio thread performs the voices too so one thread less is needed.
+    size_t const ncores = static_cast<size_t>(std::max(SystemStats::getNumCpus(), 1));
+    size_t const nthreads = std::min(nvoices, ncores) - 1;
+    m_running = true;
+    for(size_t i = 0; i < nthreads; ++i)
+    {
+        m_threads.push_back(std::make_unique<Worker>(*this));
+        m_threads.back()->startThread(10);
+    }
+    m_owner.setThis();
+}
+
+void CamomileVoices::close()
+{
+    m_running = false;
+    ++m_generation;
+    m_generation.notify_all();
+    for(auto& thread : m_threads)
+    {
+        thread->stopThread(-1);
+    }
+    m_threads.clear();
+    m_voices.clear();
+    m_owner.setThis();
+}
+
+void CamomileVoices::prepare(int nouts, double samplerate)
+{
+    if(m_voices.empty())
+    {
+        return;
+    }
+    size_t const blocksize = static_cast<size_t>(m_owner.getBlockSize());
+    m_inputs.assign(blocksize, 0.f);
+    m_stamp = 0;
+    for(auto& voice : m_voices)
+    {
+        voice->prepareDSP(0, nouts, samplerate);
+        voice->startDSP();
+        voice->processMessages();
+        voice->outputs.assign(static_cast<size_t>(nouts) * blocksize, 0.f);
+        voice->active = false;
+        voice->pitch = -1;
+        voice->stamp = 0;
+    }
+    m_owner.setThis();
+}
+
+void CamomileVoices::release()
+{
+    for(auto& voice : m_voices)
+    {
+        voice->releaseDSP();
+        voice->processMessages();
+    }
+    m_owner.setThis();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          MESSAGES                                        //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+CamomileVoices::Voice* CamomileVoices::allocateVoice(int channel, int pitch) noexcept
+{
+    // The voice that already plays the note, then the free voice released for the longest
+    // time, then the oldest voice.
+    Voice* released = nullptr;
+    Voice* oldest = nullptr;
+    for(auto& voice : m_voices)
+    {
+        if(voice->active && voice->channel == channel && voice->pitch == pitch)
+        {
+            return voice.get();
+        }
+        else if(!voice->active && (released == nullptr || voice->stamp < released->stamp))
+        {
+            released = voice.get();
+        }
+        else if(voice->active && (oldest == nullptr || voice->stamp < oldest->stamp))
+        {
+            oldest = voice.get();
+        }
+    }
+    return released != nullptr ? released : oldest;
+}
+
+void CamomileVoices::sendMidi(MidiMessage const& message)
+{
+    if(m_voices.empty())
+    {
+        return;
+    }
+    int const channel = message.getChannel();
+    if(message.isNoteOn())
+    {
+        Voice* voice = allocateVoice(channel, message.getNoteNumber());
+        if(voice->active && (voice->channel != channel || voice->pitch != message.getNoteNumber()))
+        {
+            voice->sendNoteOn(voice->channel, voice->pitch, 0);
+        }
+        voice->sendNoteOn(channel, message.getNoteNumber(), message.getVelocity());
+        voice->channel = channel;
+        voice->pitch = message.getNoteNumber();
+        voice->active = true;
+        voice->stamp = ++m_stamp;
+    }
+    else if(message.isNoteOff() || message.isAftertouch())
+    {
+        for(auto& voice : m_voices)
+        {
+            if(voice->active && voice->channel == channel && voice->pitch == message.getNoteNumber())
+            {
+                if(message.isAftertouch())
+                {
+                    voice->sendPolyAfterTouch(channel, message.getNoteNumber(), message.getAfterTouchValue());
+                }
+                else
+                {
+                    voice->sendNoteOn(channel, message.getNoteNumber(), 0);
+                    voice->active = false;
+                    voice->stamp = ++m_stamp;
+                }
+                break;
+            }
+        }
+    }
+    else
+    {
+        for(auto& voice : m_voices)
+        {
+            if(message.isController()) {
+                voice->sendControlChange(channel, message.getControllerNumber(), message.getControllerValue()); }
+            else if(message.isPitchWheel()) {
+                voice->sendPitchBend(channel, message.getPitchWheelValue() - 8192); }
+            else if(message.isChannelPressure()) {
+                voice->sendAfterTouch(channel, message.getChannelPressureValue()); }
+            else if(message.isProgramChange()) {
+                voice->sendProgramChange(channel, message.getProgramChangeNumber()); }
+        }
+    }
+    m_owner.setThis();
+}
+
+void CamomileVoices::sendList(const char* receiver, const std::vector<pd::Atom>& list)
+{
+    for(auto& voice : m_voices)
+    {
+        voice->sendList(receiver, list);
+    }
+    if(!m_voices.empty())
+    {
+        m_owner.setThis();
+    }
+}
+
+void CamomileVoices::processPrints()
+{
+    for(auto& voice : m_voices)
+    {
+        voice->processPrints();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                                          PERFORM                                         //
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+void CamomileVoices::run()
+{
+    uint32_t generation = m_generation.load();
+    while(m_running)
+    {
+        m_generation.wait(generation);
+        generation = m_generation.load();
+        if(m_running)
+        {
+            performVoices();
+        }
+    }
+}
+
+void CamomileVoices::performVoices() noexcept
+{
+    // The voices are taken one by one by the threads that are available, so a thread that
+    // finishes a light voice takes the next one instead of waiting for the others.
+    size_t index;
+    while((index = m_next.fetch_add(1, std::memory_order_acq_rel)) < m_voices.size())
+    {
+        Voice& voice = *m_voices[index];
+        voice.performDSP(m_inputs.data(), voice.outputs.data());
+        m_done.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void CamomileVoices::startTick() noexcept
+{
+    if(m_voices.empty())
+    {
+        return;
+    }
+    m_done.store(0, std::memory_order_relaxed);
+    m_next.store(0, std::memory_order_release);
+    if(!m_threads.empty())
+    {
+        m_generation.fetch_add(1, std::memory_order_release);
+        m_generation.notify_all();
+    }
+    m_performing = true;
+}
+
+void CamomileVoices::finishTick(float* outputs) noexcept
+{
+    if(!m_performing)
+    {
+        return;
+    }
+    m_performing = false;
+    performVoices();
+    while(m_done.load(std::memory_order_acquire) < m_voices.size())
+    {
+        std::this_thread::yield();
+    }
+    m_owner.setThis();
+    for(auto const& voice : m_voices)
+    {
+        float const* samples = voice->outputs.data();
+        for(size_t i = 0; i < voice->outputs.size(); ++i)
+        {
+            outputs[i] += samples[i];
+        }
+        voice->processMessages();
+        voice->processMidi();
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Pd/PdInstance.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// ======================================================================================== //
+//                                          VOICES                                          //
+// ======================================================================================== //
+
+//! @brief Runs the voices of a polyphonic plugin in their own Pd instances.
+//! @details Each voice opens the voice patch in its own Pd instance. The notes are allocated\n
+//! to the voices (a free voice or the oldest one is stolen), the other MIDI events and the\n
+//! parameters are sent to all the voices. At each tick, the voices are performed by a pool\n
+//! of threads and by the audio thread, then their outputs are added to the outputs of the\n
+//! main patch. The voice patch receives its index on the "voice" receiver when it is opened.\n
+//! The messages sent to "camomile" and the MIDI events produced by the voices are forwarded\n
+//! to the owner by the audio thread at the end of the tick.\n
+//! The threads of the pool have the highest priority (real-time when the system allows it)\n
+//! because the audio thread waits for them.
+class CamomileVoices
+{
+public:
+    CamomileVoices(pd::Instance& owner);
+    ~CamomileVoices();
+
+    //! @brief Opens the voice patch in each voice and starts the threads.
+    void open(std::string const& path, std::string const& name, size_t nvoices);
+
+    //! @brief Stops the threads and closes the voices.
+    void close();
+
+    //! @brief Gets if the voices are opened.
+    bool isOpened() const noexcept { return !m_voices.empty(); }
+
+    //! @brief Prepares the DSP of the voices.
+    void prepare(int nouts, double samplerate);
+
+    //! @brief Releases the DSP of the voices.
+    void release();
+
+    //! @brief Allocates a MIDI message to the voices.
+    void sendMidi(MidiMessage const& message);
+
+    //! @brief Sends a list to all the voices.
+    void sendList(const char* receiver, const std::vector<pd::Atom>& list);
+
+    //! @brief Starts to perform the voices on the threads of the pool.
+    void startTick() noexcept;
+
+    //! @brief Performs the remaining voices, waits for the others and adds their outputs.
+    //! @details The outputs have the same layout as the buffers given to performDSP. The\n
+    //! messages and the MIDI events of the voices are then forwarded to the owner.
+    void finishTick(float* outputs) noexcept;
+
+    //! @brief Forwards the prints of the voices to the owner.
+    void processPrints();
+
+private:
+    class Voice;
+    class Worker;
+
+    void run();
+    void performVoices() noexcept;
+    Voice* allocateVoice(int channel, int pitch) noexcept;
+
+    pd::Instance&                       m_owner;
+    std::vector<std::unique_ptr<Voice>> m_voices;
+    std::vector<std::unique_ptr<Worker>> m_threads;
+    std::vector<float>                  m_inputs;
+    uint64_t                            m_stamp = 0;
+
+    std::atomic<uint32_t>               m_generation {0};
+    std::atomic<size_t>                 m_next {0};
+    std::atomic<size_t>                 m_done {0};
+    std::atomic<bool>                   m_running {false};
+    bool                                m_performing = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CamomileVoices)
+};
@@ -0,0 +1,57 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// ======================================================================================== //
+//                                          WORKER                                          //
+// ======================================================================================== //
+
+//! @brief The interface of a processor that can perform its non real-time work on a thread\n
+//! provided by the host.
+//! @details The wrapper of the plugin format (LV2 worker extension) schedules the work\n
+//! requested by the processor from the audio thread, calls performWork() on the worker\n
+//! thread of the host and performWorkResponse() on the audio thread between two blocks.\n
+//! The worker can be called by the audio thread so the reload of the patch, that locks the\n
+//! message manager and suspends the processing, is never performed by the worker.
+class CamomileWorker
+{
+public:
+    //! @brief The types of work, a request can combine several types.
+    enum Work : uint32_t
+    {
+        WorkJobs    = 1,    //!< The jobs requested by the patch.
+        WorkRestore = 2     //!< The restoration of a state.
+    };
+
+    //! @brief The function that schedules work, returns false if the work can't be scheduled.
+    typedef bool (*Scheduler)(void* handle, uint32_t work);
+
+    virtual ~CamomileWorker() = default;
+
+    //! @brief Uses the worker of the host instead of the threads of the processor.
+    //! @details The method must be called before the processing starts.
+    virtual void useHostWorker() = 0;
+
+    //! @brief Schedules the work requested since the last call.
+    //! @details The method is called by the audio thread after the processing.
+    virtual void scheduleWork(Scheduler scheduler, void* handle) = 0;
+
+    //! @brief Schedules the restoration of a state.
+    //! @details The data are parsed during the call because the paths can only be converted\n
+    //! by the host at this time. The arrays are written by performWork() on the worker thread\n
+    //! and the other values are loaded in the patch by the response on the audio thread.\n
+    //! Returns false if the state must be restored synchronously.
+    virtual bool scheduleState(const void* data, int sizeInBytes, Scheduler scheduler, void* handle) = 0;
+
+    //! @brief Performs the work on the worker thread.
+    virtual void performWork(uint32_t work) = 0;
+
+    //! @brief Performs the response of the work on the audio thread.
+    virtual void performWorkResponse(uint32_t work) = 0;
+};
@@ -0,0 +1,333 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "Renderer.h"
+#include "../PluginEnvironment.h"
+#include "../PluginParameter.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// ======================================================================================== //
+//                                          JOB                                             //
+// ======================================================================================== //
+
+CamomileRenderJob CamomileRenderJob::parse(StringArray const& args)
+{
+    CamomileRenderJob job;
+    for(int i = 0; i < args.size(); ++i)
+    {
+        String const& option = args[i];
+        if(i + 1 >= args.size())
+        {
+            throw std::string("option ") + option.toStdString() + std::string(" without value");
+        }
+        String const& value = args[++i];
+        if(option == "-i")
+        {
+            job.audio = value.toStdString();
+        }
+        else if(option == "-m")
+        {
+            job.midi = value.toStdString();
+        }
+        else if(option == "-a")
+        {
+            job.automation = value.toStdString();
+        }
+        else if(option == "-o")
+        {
+            job.output = value.toStdString();
+        }
+        else if(option == "-sr")
+        {
+            job.samplerate = value.getDoubleValue();
+        }
+        else if(option == "-tail")
+        {
+            job.tail = value.getDoubleValue();
+        }
+        else if(option == "-bits")
+        {
+            job.bitdepth = value.getIntValue();
+        }
+        else
+        {
+            throw std::string("unknown option ") + option.toStdString();
+        }
+    }
+    if(job.output.empty())
+    {
+        throw std::string("no output file");
+    }
+    return job;
+}
+
+// ======================================================================================== //
+//                                          RENDERER                                        //
+// ======================================================================================== //
+
+CamomileRenderer::CamomileRenderer() : pd::Instance("camomile")
+{
+    m_atoms_param.resize(2);
+}
+
+CamomileRenderer::~CamomileRenderer()
+{
+    closePatch();
+}
+
+void CamomileRenderer::receivePrint(const std::string& message)
+{
+    m_prints.add(String(message));
+}
+
+std::vector<CamomileRenderer::automation_point> CamomileRenderer::readAutomation(std::string const& path)
+{
+    std::vector<automation_point> points;
+    std::ifstream stream(path);
+    if(!stream.is_open())
+    {
+        throw std::string("can't read the automation file ") + path;
+    }
+    std::string line;
+    size_t number = 0;
+    while(std::getline(stream, line))
+    {
+        ++number;
+        if(line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream values(line);
+        automation_point point;
+        if(!(values >> point.time >> point.index >> point.value))
+        {
+            throw std::string("automation file ") + path + std::string(" wrong syntax at line ") + std::to_string(number);
+        }
+        points.push_back(point);
+    }
+    std::stable_sort(points.begin(), points.end(), [](automation_point const& a, automation_point const& b)
+    {
+        return a.time < b.time;
+    });
+    return points;
+}
+
+void CamomileRenderer::sendMidiMessage(MidiMessage const& message)
+{
+    if(message.isNoteOn()) {
+        sendNoteOn(message.getChannel(), message.getNoteNumber(), message.getVelocity()); }
+    else if(message.isNoteOff()) {
+        sendNoteOn(message.getChannel(), message.getNoteNumber(), 0); }
+    else if(message.isController()) {
+        sendControlChange(message.getChannel(), message.getControllerNumber(), message.getControllerValue()); }
+    else if(message.isPitchWheel()) {
+        sendPitchBend(message.getChannel(), message.getPitchWheelValue() - 8192); }
+    else if(message.isChannelPressure()) {
+        sendAfterTouch(message.getChannel(), message.getChannelPressureValue()); }
+    else if(message.isAftertouch()) {
+        sendPolyAfterTouch(message.getChannel(), message.getNoteNumber(), message.getAfterTouchValue()); }
+    else if(message.isProgramChange()) {
+        sendProgramChange(message.getChannel(), message.getProgramChangeNumber()); }
+    else if(message.isSysEx()) {
+        for(int i = 0; i < message.getSysExDataSize(); ++i)  {
+            sendSysEx(0, static_cast<int>(message.getSysExData()[i]));
+        }
+    }
+    if(!message.isMetaEvent())
+    {
+        for(int i = 0; i < message.getRawDataSize(); i++)  {
+            sendMidiByte(0, static_cast<int>(message.getRawData()[i]));
+        }
+    }
+}
+
+void CamomileRenderer::sendDefaultParameters()
+{
+    auto const& params = CamomileEnvironment::getParams();
+    for(size_t i = 0; i < params.size(); ++i)
+    {
+        try
+        {
+            std::unique_ptr<CamomileAudioParameter> param(CamomileAudioParameter::parse(params[i]));
+            if(param)
+            {
+                m_atoms_param[0] = static_cast<float>(i+1);
+                m_atoms_param[1] = param->convertFrom0to1(param->getDefaultValue());
+                sendList("param", m_atoms_param);
+            }
+        }
+        catch(std::string const& message)
+        {
+            m_prints.add(String("camomile parameter ") + String(i+1) + String(": ") + String(message));
+        }
+    }
+}
+
+std::string CamomileRenderer::render(CamomileRenderJob const& job, std::mutex& mutex)
+{
+    m_prints.clear();
+    AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    AudioBuffer<float> input;
+    double samplerate = job.samplerate;
+    if(!job.audio.empty())
+    {
+        std::unique_ptr<AudioFormatReader> reader(formats.createReaderFor(File(job.audio)));
+        if(!reader)
+        {
+            return std::string("can't read the audio file ") + job.audio;
+        }
+        if(samplerate <= 0.)
+        {
+            samplerate = reader->sampleRate;
+        }
+        else if(samplerate != reader->sampleRate)
+        {
+            return std::string("the sample rate of the audio file ") + job.audio + std::string(" doesn't match");
+        }
+        input.setSize(static_cast<int>(reader->numChannels), static_cast<int>(reader->lengthInSamples));
+        reader->read(&input, 0, static_cast<int>(reader->lengthInSamples), 0, true, true);
+    }
+    if(samplerate <= 0.)
+    {
+        samplerate = 44100.;
+    }
+
+    MidiMessageSequence midi;
+    if(!job.midi.empty())
+    {
+        FileInputStream stream(File(job.midi));
+        MidiFile file;
+        if(!stream.openedOk() || !file.readFrom(stream))
+        {
+            return std::string("can't read the MIDI file ") + job.midi;
+        }
+        file.convertTimestampTicksToSeconds();
+        for(int i = 0; i < file.getNumTracks(); ++i)
+        {
+            midi.addSequence(*file.getTrack(i), 0.);
+        }
+        midi.sort();
+    }
+
+    std::vector<automation_point> automation;
+    if(!job.automation.empty())
+    {
+        try
+        {
+            automation = readAutomation(job.automation);
+        }
+        catch(std::string const& message)
+        {
+            return message;
+        }
+    }
+
+    // The length covers the inputs and the tail of the plugin
+    double duration = static_cast<double>(input.getNumSamples()) / samplerate;
+    duration = std::max(duration, midi.getEndTime());
+    duration = std::max(duration, automation.empty() ? 0. : automation.back().time);
+    duration += job.tail >= 0. ? job.tail : static_cast<double>(CamomileEnvironment::getTailLengthSeconds());
+    int const length = static_cast<int>(std::ceil(duration * samplerate));
+
+    int nins = 2, nouts = 2;
+    auto const& layouts = CamomileEnvironment::getBusesLayouts();
+    if(!layouts.empty())
+    {
+        nins = 0; nouts = 0;
+        for(auto const& bus : layouts.front())
+        {
+            nins  += static_cast<int>(bus.inputs);
+            nouts += static_cast<int>(bus.outputs);
+        }
+    }
+    if(nouts == 0)
+    {
+        return std::string("the plugin has no audio output");
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        openPatch(CamomileEnvironment::getPatchPath(), CamomileEnvironment::getPatchName());
+    }
+    prepareDSP(std::max(nins, 2), std::max(nouts, 2), samplerate);
+    startDSP();
+    sendDefaultParameters();
+    processMessages();
+    processPrints();
+
+    int const blocksize = Instance::getBlockSize();
+    m_buffer_in.assign(static_cast<size_t>(std::max(nins, 2) * blocksize), 0.f);
+    m_buffer_out.assign(static_cast<size_t>(std::max(nouts, 2) * blocksize), 0.f);
+    AudioBuffer<float> output(nouts, length);
+    output.clear();
+
+    int midi_index = 0;
+    size_t automation_index = 0;
+    for(int position = 0; position < length; position += blocksize)
+    {
+        int const nsamples = std::min(blocksize, length - position);
+        double const end = static_cast<double>(position + blocksize) / samplerate;
+        for(; midi_index < midi.getNumEvents(); ++midi_index)
+        {
+            auto const& message = midi.getEventPointer(midi_index)->message;
+            if(message.getTimeStamp() >= end)
+            {
+                break;
+            }
+            sendMidiMessage(message);
+        }
+        for(; automation_index < automation.size() && automation[automation_index].time < end; ++automation_index)
+        {
+            m_atoms_param[0] = static_cast<float>(automation[automation_index].index);
+            m_atoms_param[1] = automation[automation_index].value;
+            sendList("param", m_atoms_param);
+        }
+
+        std::fill(m_buffer_in.begin(), m_buffer_in.end(), 0.f);
+        int const available = std::min(blocksize, input.getNumSamples() - position);
+        for(int j = 0; j < nins && j < input.getNumChannels() && available > 0; ++j)
+        {
+            std::copy_n(input.getReadPointer(j, position), available, m_buffer_in.data() + j * blocksize);
+        }
+        performDSP(m_buffer_in.data(), m_buffer_out.data());
+        for(int j = 0; j < nouts; ++j)
+        {
+            std::copy_n(m_buffer_out.data() + j * blocksize, nsamples, output.getWritePointer(j, position));
+        }
+
+        processMessages();
+        processPrints();
+        processMidi();
+    }
+    releaseDSP();
+    closePatch();
+
+    File file(job.output);
+    file.deleteFile();
+    std::unique_ptr<FileOutputStream> stream(file.createOutputStream());
+    if(!stream)
+    {
+        return std::string("can't create the file ") + job.output;
+    }
+    WavAudioFormat wav;
+    std::unique_ptr<AudioFormatWriter> writer(wav.createWriterFor(stream.get(), samplerate,
+                                                                  static_cast<unsigned int>(nouts),
+                                                                  job.bitdepth, {}, 0));
+    if(!writer)
+    {
+        return std::string("can't write the file ") + job.output;
+    }
+    stream.release();
+    if(!writer->writeFromAudioSampleBuffer(output, 0, length))
+    {
+        return std::string("can't write the file ") + job.output;
+    }
+    return std::string();
+}
@@ -0,0 +1,75 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Pd/PdInstance.hpp"
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ======================================================================================== //
+//                                          JOB                                             //
+// ======================================================================================== //
+
+//! @brief The description of an offline rendering.
+struct CamomileRenderJob
+{
+    std::string audio;              //!< The audio file used as input (optional).
+    std::string midi;               //!< The standard MIDI file used as input (optional).
+    std::string automation;         //!< The parameters automation file (optional).
+    std::string output;             //!< The WAV file written.
+    double      samplerate = 0.;    //!< The sample rate, zero uses the one of the audio file or 44100.
+    double      tail = -1.;         //!< The tail in seconds, negative uses the tail of the plugin.
+    int         bitdepth = 24;      //!< The bit depth of the WAV file.
+
+    //! @brief Parses a job from the command line arguments.
+    //! @details Throws a std::string if the arguments are invalid.
+    static CamomileRenderJob parse(StringArray const& args);
+};
+
+// ======================================================================================== //
+//                                          RENDERER                                        //
+// ======================================================================================== //
+
+//! @brief Renders the patch of the plugin offline as fast as possible.
+//! @details The MIDI events and the parameters automation are sent at the beginning of\n
+//! the Pd tick that contains them. The automation file contains one point per line with\n
+//! the time in seconds, the index of the parameter and its value: "0.5 2 0.25".
+class CamomileRenderer : public pd::Instance
+{
+public:
+    CamomileRenderer();
+    ~CamomileRenderer();
+
+    //! @brief Renders a job and returns the error or an empty string.
+    //! @details The mutex is locked while the patch is opened, it serializes the opening\n
+    //! with the creation and the destruction of the other instances.
+    std::string render(CamomileRenderJob const& job, std::mutex& mutex);
+
+    //! @brief Gets the messages printed by the patch during the rendering.
+    StringArray const& getPrints() const noexcept { return m_prints; }
+
+    void receivePrint(const std::string& message) override;
+private:
+
+    struct automation_point
+    {
+        double time;
+        int    index;
+        float  value;
+    };
+
+    static std::vector<automation_point> readAutomation(std::string const& path);
+    void sendMidiMessage(MidiMessage const& message);
+    void sendDefaultParameters();
+
+    std::vector<pd::Atom> m_atoms_param;
+    std::vector<float>    m_buffer_in;
+    std::vector<float>    m_buffer_out;
+    StringArray           m_prints;
+};
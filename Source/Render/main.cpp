@@ -0,0 +1,137 @@
+/*
+ // Copyright (c) 2015-2018 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "Renderer.h"
+#include "../PluginEnvironment.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// ======================================================================================== //
+//                                          MAIN                                            //
+// ======================================================================================== //
+
+static void printUsage()
+{
+    std::cout << "usage: camomile-render <plugin folder> [-j threads] (-b batch file | job options)\n"
+              << "job options:\n"
+              << "  -o file      the WAV file written (required)\n"
+              << "  -i file      the audio file used as input\n"
+              << "  -m file      the standard MIDI file used as input\n"
+              << "  -a file      the parameters automation file (time index value per line)\n"
+              << "  -sr value    the sample rate (default: the one of the audio file or 44100)\n"
+              << "  -tail value  the tail in seconds (default: the tail of the plugin)\n"
+              << "  -bits value  the bit depth of the WAV file (default: 24)\n"
+              << "A batch file contains the options of one job per line, the jobs are rendered in parallel.\n";
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        printUsage();
+        return 1;
+    }
+    if(!CamomileEnvironment::initialize(argv[1]))
+    {
+        for(auto const& error : CamomileEnvironment::getErrors())
+        {
+            std::cerr << "error: " << error << "\n";
+        }
+        return 1;
+    }
+
+    int nthreads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    std::vector<CamomileRenderJob> jobs;
+    try
+    {
+        StringArray args;
+        for(int i = 2; i < argc; ++i)
+        {
+            args.add(String(CharPointer_UTF8(argv[i])));
+        }
+        int const jindex = args.indexOf("-j");
+        if(jindex >= 0 && jindex + 1 < args.size())
+        {
+            nthreads = std::max(args[jindex+1].getIntValue(), 1);
+            args.removeRange(jindex, 2);
+        }
+        int const bindex = args.indexOf("-b");
+        if(bindex >= 0 && bindex + 1 < args.size())
+        {
+            StringArray lines;
+            File(args[bindex+1]).readLines(lines);
+            for(auto const& line : lines)
+            {
+                if(line.trim().isNotEmpty() && !line.trim().startsWithChar('#'))
+                {
+                    jobs.push_back(CamomileRenderJob::parse(StringArray::fromTokens(line, true)));
+                }
+            }
+        }
+        else
+        {
+            jobs.push_back(CamomileRenderJob::parse(args));
+        }
+    }
+    catch(std::string const& message)
+    {
+        std::cerr << "error: " << message << "\n";
+        printUsage();
+        return 1;
+    }
+
+    if(jobs.empty())
+    {
+        std::cerr << "error: no job to render\n";
+        return 1;
+    }
+
+    // Each job uses its own Pd instance. The creation and the destruction of the instances
+    // and the opening of the patches are serialized, the rendering runs in parallel.
+    std::mutex instances_mutex, output_mutex;
+    std::atomic<int> nerrors(0);
+    {
+        ThreadPool pool(std::min(nthreads, static_cast<int>(jobs.size())));
+        for(auto const& job : jobs)
+        {
+            pool.addJob([&, job]()
+            {
+                std::unique_ptr<CamomileRenderer> renderer;
+                {
+                    std::lock_guard<std::mutex> guard(instances_mutex);
+                    renderer = std::make_unique<CamomileRenderer>();
+                }
+                auto const error = renderer->render(job, instances_mutex);
+                {
+                    std::lock_guard<std::mutex> guard(output_mutex);
+                    for(auto const& print : renderer->getPrints())
+                    {
+                        std::cout << job.output << ": " << print << "\n";
+                    }
+                    if(error.empty())
+                    {
+                        std::cout << job.output << ": done\n";
+                    }
+                    else
+                    {
+                        std::cerr << job.output << ": error: " << error << "\n";
+                        ++nerrors;
+                    }
+                }
+                std::lock_guard<std::mutex> guard(instances_mutex);
+                renderer.reset();
+            });
+        }
+        while(pool.getNumJobs() > 0)
+        {
+            Thread::sleep(10);
+        }
+    }
+    return nerrors > 0 ? 1 : 0;
+}